@@ -19,16 +19,28 @@
 #include <SDL2/SDL_ttf.h>
 
 #include <assert.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <limits>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 #endif
 
@@ -55,6 +67,25 @@ struct GvColor {
       : r(r), g(g), b(b), a(a) {}
 };
 
+// What Flush and NewTime do when the viewer is behind the producer.
+struct GvBackpressure {
+  enum Policy {
+    kKeepAll,     // keep every page
+    kBlock,       // wait until the viewer shows a page
+    kDropOldest,  // drop the oldest page the viewer has not shown
+    kCoalesce,    // replace the newest page the viewer has not shown
+  };
+};
+
+// Milliseconds from the Run call until each startup step finished. -1 means
+// the step has not finished (or was not needed) yet.
+struct GvStartupStats {
+  double first_page_ms = -1;   // the first page was flushed
+  double window_ms = -1;       // the window and the GL context were created
+  double first_frame_ms = -1;  // the first frame was shown
+  double font_ms = -1;         // the font was loaded
+};
+
 #ifdef ENABLE_GV
 template <class T>
 struct Point {
@@ -95,6 +126,17 @@ class BinaryWriter {
     buf.insert(buf.end(), s.begin(), s.end());
   }
 
+  void Write(const std::vector<char>& v) {
+    const size_t n = v.size();
+    Write(n);
+    buf.insert(buf.end(), v.begin(), v.end());
+  }
+
+  void WriteBytes(const void* p, size_t n) {
+    const char* s = static_cast<const char*>(p);
+    buf.insert(buf.end(), s, s + n);
+  }
+
  private:
   std::vector<char>& buf;
 };
@@ -116,6 +158,18 @@ class BinaryReader {
     pos_ += n;
   }
 
+  void Read(std::vector<char>& v) {
+    size_t n;
+    Read(n);
+    v.assign(&buf[pos_], &buf[pos_] + n);
+    pos_ += n;
+  }
+
+  void ReadBytes(void* p, size_t n) {
+    memcpy(p, &buf[pos_], n);
+    pos_ += n;
+  }
+
   void pos(size_t pos) { pos_ = pos; }
   size_t pos() const { return pos_; }
 
@@ -128,8 +182,211 @@ template <class T>
 struct RenderArgs {
   SDL_Renderer* renderer;
   TTF_Font* font;
-  std::function<void(double, double, double, int, int, GvColor, const char*)>
+  std::function<bool(int, int*, int*)> text_size_func;
+  std::function<void(double, double, double, int, int, GvColor, int)>
       render_text_func;
+  std::function<int(int, std::vector<char>&)> format_text_func;
+  bool coarse = false;  // draw with less detail, for a first quick pass
+};
+
+// Texture of a rendered text. The glyphs are white so that one texture can be
+// drawn in any color.
+struct GvTextTexture {
+  GLuint tex = 0;
+  int w = 0, h = 0;            // texture size (power of two)
+  int text_w = 0, text_h = 0;  // size of the text in the texture
+};
+
+// Ear clipping triangulation of a polygon which may be concave and have
+// holes. The holes are first joined to the outline by bridge edges.
+template <class T>
+class GvTriangulator {
+ public:
+  // Rings after the first are holes. Appends the triangles to out as x, y
+  // pairs.
+  void Run(const std::vector<T>* vx, const std::vector<T>* vy, size_t rings,
+           std::vector<T>& out) {
+    if (rings == 0) return;
+    CopyRing(vx[0], vy[0], true, poly_);
+    if (poly_.size() < 3) return;
+    holes_.resize(rings - 1);
+    for (size_t k = 1; k < rings; ++k) {
+      CopyRing(vx[k], vy[k], false, holes_[k - 1]);
+    }
+    // Right to left, so that a bridge never crosses a hole joined later.
+    std::sort(holes_.begin(), holes_.end(),
+              [](const std::vector<Point<T>>& a,
+                 const std::vector<Point<T>>& b) {
+                return MaxX(a) > MaxX(b);
+              });
+    for (const auto& hole : holes_) {
+      if (hole.size() >= 3) Bridge(hole);
+    }
+    Clip(out);
+  }
+
+ private:
+  std::vector<Point<T>> poly_;
+  std::vector<std::vector<Point<T>>> holes_;
+  std::vector<Point<T>> spliced_;
+  std::vector<int> prev_, next_;
+
+  static T Cross(const Point<T>& a, const Point<T>& b, const Point<T>& c) {
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+  }
+
+  static bool Same(const Point<T>& a, const Point<T>& b) {
+    return a.x == b.x && a.y == b.y;
+  }
+
+  static T MaxX(const std::vector<Point<T>>& ring) {
+    T x = std::numeric_limits<T>::lowest();
+    for (const auto& p : ring) x = std::max(x, p.x);
+    return x;
+  }
+
+  // Copies a ring counterclockwise for the outline and clockwise for holes.
+  static void CopyRing(const std::vector<T>& vx, const std::vector<T>& vy,
+                       bool outline, std::vector<Point<T>>& dst) {
+    const size_t n = std::min(vx.size(), vy.size());
+    dst.clear();
+    T area = 0;
+    for (size_t i = 0; i < n; ++i) {
+      const size_t j = i + 1 < n ? i + 1 : 0;
+      area += vx[i] * vy[j] - vx[j] * vy[i];
+      if (dst.empty() || !Same(dst.back(), Point<T>(vx[i], vy[i]))) {
+        dst.emplace_back(vx[i], vy[i]);
+      }
+    }
+    if ((area > 0) != outline) std::reverse(dst.begin(), dst.end());
+  }
+
+  // Joins hole to poly_ with an edge from its rightmost vertex to a vertex
+  // of poly_ visible from it.
+  void Bridge(const std::vector<Point<T>>& hole) {
+    const int hn = static_cast<int>(hole.size());
+    int hm = 0;
+    for (int i = 1; i < hn; ++i) {
+      if (hole[i].x > hole[hm].x) hm = i;
+    }
+    const Point<T> m = hole[hm];
+
+    // Nearest edge crossed by the ray from m to +x. Only edges with the
+    // inside on their left, going to +y, can be hit from inside.
+    const int n = static_cast<int>(poly_.size());
+    int bridge = -1;
+    T hit_x = std::numeric_limits<T>::max();
+    for (int i = 0; i < n; ++i) {
+      const Point<T>& a = poly_[i];
+      const Point<T>& b = poly_[i + 1 < n ? i + 1 : 0];
+      if (!(a.y <= m.y && m.y <= b.y && a.y < b.y)) continue;
+      const T x = a.x + (m.y - a.y) * (b.x - a.x) / (b.y - a.y);
+      if (m.x <= x && x < hit_x) {
+        hit_x = x;
+        bridge = a.x > b.x ? i : (i + 1 < n ? i + 1 : 0);
+      }
+    }
+    if (bridge < 0) return;
+
+    // The bridge goes to the vertex in the triangle (m, hit, poly_[bridge])
+    // closest in angle to the ray; it is poly_[bridge] or the vertex the
+    // ray hits if there is none. Earlier bridges duplicate vertices, so of
+    // the copies only one has m inside its wedge.
+    const Point<T> hit(hit_x, m.y);
+    const Point<T> p = poly_[bridge];
+    int best = -1;
+    T best_tan = std::numeric_limits<T>::max();
+    for (int i = 0; i < n; ++i) {
+      const Point<T>& v = poly_[i];
+      if (v.x < m.x) continue;
+      if (!Same(v, p)) {
+        const T d1 = Cross(m, hit, v);
+        const T d2 = Cross(hit, p, v);
+        const T d3 = Cross(p, m, v);
+        const bool inside = (d1 >= 0 && d2 >= 0 && d3 >= 0) ||
+                            (d1 <= 0 && d2 <= 0 && d3 <= 0);
+        if (!inside) continue;
+      }
+      if (!LocallyInside(i, m)) continue;
+      const T tan = v.x > m.x ? std::abs(v.y - m.y) / (v.x - m.x) : 0;
+      if (best < 0 || tan < best_tan ||
+          (tan == best_tan && v.x < poly_[best].x)) {
+        best_tan = tan;
+        best = i;
+      }
+    }
+    if (best >= 0) bridge = best;
+
+    spliced_.clear();
+    spliced_.insert(spliced_.end(), poly_.begin(), poly_.begin() + bridge + 1);
+    for (int i = 0; i <= hn; ++i) spliced_.push_back(hole[(hm + i) % hn]);
+    spliced_.insert(spliced_.end(), poly_.begin() + bridge, poly_.end());
+    poly_.swap(spliced_);
+  }
+
+  // True if the direction from poly_[i] to q is inside the polygon at i.
+  bool LocallyInside(int i, const Point<T>& q) const {
+    const int n = static_cast<int>(poly_.size());
+    const Point<T>& prev = poly_[i > 0 ? i - 1 : n - 1];
+    const Point<T>& v = poly_[i];
+    const Point<T>& next = poly_[i + 1 < n ? i + 1 : 0];
+    if (Cross(prev, v, next) >= 0) {
+      return Cross(v, next, q) >= 0 && Cross(prev, v, q) >= 0;
+    }
+    return Cross(v, next, q) > 0 || Cross(prev, v, q) > 0;
+  }
+
+  bool IsEar(int a, int b, int c) const {
+    const Point<T>& pa = poly_[a];
+    const Point<T>& pb = poly_[b];
+    const Point<T>& pc = poly_[c];
+    if (Cross(pa, pb, pc) <= 0) return false;
+    for (int i = next_[c]; i != a; i = next_[i]) {
+      const Point<T>& p = poly_[i];
+      if (Same(p, pa) || Same(p, pb) || Same(p, pc)) continue;
+      if (Cross(pa, pb, p) >= 0 && Cross(pb, pc, p) >= 0 &&
+          Cross(pc, pa, p) >= 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void Emit(int a, int b, int c, std::vector<T>& out) const {
+    if (Cross(poly_[a], poly_[b], poly_[c]) == 0) return;
+    for (int i : {a, b, c}) {
+      out.push_back(poly_[i].x);
+      out.push_back(poly_[i].y);
+    }
+  }
+
+  void Clip(std::vector<T>& out) {
+    const int n = static_cast<int>(poly_.size());
+    prev_.resize(n);
+    next_.resize(n);
+    for (int i = 0; i < n; ++i) {
+      prev_[i] = i > 0 ? i - 1 : n - 1;
+      next_[i] = i + 1 < n ? i + 1 : 0;
+    }
+    int i = 0;
+    int stall = 0;
+    for (int remaining = n; remaining > 3;) {
+      const int a = prev_[i];
+      const int c = next_[i];
+      // A self-intersecting polygon may have no ear left; clip anyway.
+      if (stall >= remaining || IsEar(a, i, c)) {
+        Emit(a, i, c, out);
+        next_[a] = c;
+        prev_[c] = a;
+        --remaining;
+        stall = 0;
+      } else {
+        ++stall;
+      }
+      i = c;
+    }
+    Emit(prev_[i], i, next_[i], out);
+  }
 };
 
 template <class T>
@@ -162,14 +419,139 @@ struct GvPolygonItem {
     r.Read(dst.c);
   }
 
-  void Render(const RenderArgs<T>& r) const {
-    const auto n = vx.size();
-    glColor4f(c.r / 256.0, c.g / 256.0, c.b / 256.0, c.a / 256.0);
-    glBegin(GL_POLYGON);
-    for (int i = 0; i < n; ++i) {
-      glVertex2d(vx[i], vy[i]);
+  void Triangulate(GvTriangulator<T>& t, std::vector<T>& out) const {
+    t.Run(&vx, &vy, 1, out);
+  }
+};
+
+// Polygon with holes. Ring 0 is the outline and the others are holes.
+template <class T>
+struct GvShapeItem {
+  std::vector<std::vector<T>> vx, vy;
+  GvColor c;
+
+  T MinX() const { return *std::min_element(begin(vx[0]), end(vx[0])); }
+  T MinY() const { return *std::min_element(begin(vy[0]), end(vy[0])); }
+  T MaxX() const { return *std::max_element(begin(vx[0]), end(vx[0])); }
+  T MaxY() const { return *std::max_element(begin(vy[0]), end(vy[0])); }
+
+  // sizes[k] points of xs, ys are ring k.
+  template <typename Writer>
+  static void Write(Writer& w, const T* xs, const T* ys, const size_t* sizes,
+                    size_t rings, GvColor c) {
+    w.Write(rings);
+    for (size_t k = 0; k < rings; ++k) {
+      w.Write(sizes[k]);
+      w.WriteBytes(xs, sizeof(T) * sizes[k]);
+      w.WriteBytes(ys, sizeof(T) * sizes[k]);
+      xs += sizes[k];
+      ys += sizes[k];
+    }
+    w.Write(c);
+  }
+
+  template <typename Reader>
+  static void ReadFrom(Reader& r, GvShapeItem& dst) {
+    size_t rings;
+    r.Read(rings);
+    dst.vx.resize(rings);
+    dst.vy.resize(rings);
+    for (size_t k = 0; k < rings; ++k) {
+      size_t n;
+      r.Read(n);
+      dst.vx[k].resize(n);
+      dst.vy[k].resize(n);
+      r.ReadBytes(dst.vx[k].data(), sizeof(T) * n);
+      r.ReadBytes(dst.vy[k].data(), sizeof(T) * n);
+    }
+    r.Read(dst.c);
+  }
+
+  void Triangulate(GvTriangulator<T>& t, std::vector<T>& out) const {
+    t.Run(vx.data(), vy.data(), vx.size(), out);
+  }
+};
+
+// Connected lines of the same width as GvSDL::Line.
+template <class T>
+struct GvPolylineItem {
+  std::vector<T> vx, vy;
+  T r;
+  bool closed;
+  GvColor c;
+
+  T MinX() const { return *std::min_element(begin(vx), end(vx)) - r * 0.05; }
+  T MinY() const { return *std::min_element(begin(vy), end(vy)) - r * 0.05; }
+  T MaxX() const { return *std::max_element(begin(vx), end(vx)) + r * 0.05; }
+  T MaxY() const { return *std::max_element(begin(vy), end(vy)) + r * 0.05; }
+
+  template <typename Writer>
+  static void Write(Writer& w, const T* xs, const T* ys, size_t n, T r,
+                    bool closed, GvColor c) {
+    w.Write(n);
+    w.WriteBytes(xs, sizeof(T) * n);
+    w.WriteBytes(ys, sizeof(T) * n);
+    w.Write(r);
+    w.Write(closed);
+    w.Write(c);
+  }
+
+  template <typename Reader>
+  static void ReadFrom(Reader& r, GvPolylineItem& dst) {
+    size_t n;
+    r.Read(n);
+    dst.vx.resize(n);
+    dst.vy.resize(n);
+    r.ReadBytes(dst.vx.data(), sizeof(T) * n);
+    r.ReadBytes(dst.vy.data(), sizeof(T) * n);
+    r.Read(dst.r);
+    r.Read(dst.closed);
+    r.Read(dst.c);
+  }
+
+  // A quad per segment and bevels at the joints.
+  void Triangulate(GvTriangulator<T>&, std::vector<T>& out) const {
+    const size_t n = vx.size();
+    const size_t segments = closed ? n : n - 1;
+    if (n < 2) return;
+    const T hw = r * 0.05;
+    auto emit = [&out](T x1, T y1, T x2, T y2, T x3, T y3) {
+      out.insert(out.end(), {x1, y1, x2, y2, x3, y3});
+    };
+    bool has_last = false;
+    T last_nx = 0, last_ny = 0;
+    T first_nx = 0, first_ny = 0;
+    for (size_t i = 0; i < segments; ++i) {
+      const size_t j = i + 1 < n ? i + 1 : 0;
+      const T dx = vx[j] - vx[i];
+      const T dy = vy[j] - vy[i];
+      const T len = std::sqrt(dx * dx + dy * dy);
+      if (len == 0) continue;
+      const T nx = -dy / len * hw;
+      const T ny = dx / len * hw;
+      if (has_last) {
+        emit(vx[i], vy[i], vx[i] + last_nx, vy[i] + last_ny, vx[i] + nx,
+             vy[i] + ny);
+        emit(vx[i], vy[i], vx[i] - last_nx, vy[i] - last_ny, vx[i] - nx,
+             vy[i] - ny);
+      } else {
+        first_nx = nx;
+        first_ny = ny;
+      }
+      emit(vx[i] + nx, vy[i] + ny, vx[j] + nx, vy[j] + ny, vx[j] - nx,
+           vy[j] - ny);
+      emit(vx[i] + nx, vy[i] + ny, vx[j] - nx, vy[j] - ny, vx[i] - nx,
+           vy[i] - ny);
+      has_last = true;
+      last_nx = nx;
+      last_ny = ny;
+    }
+    if (closed && has_last) {
+      emit(vx[0], vy[0], vx[0] + last_nx, vy[0] + last_ny, vx[0] + first_nx,
+           vy[0] + first_ny);
+      emit(vx[0], vy[0], vx[0] - last_nx, vy[0] - last_ny, vx[0] - first_nx,
+           vy[0] - first_ny);
     }
-    glEnd();
   }
 };
 
@@ -177,7 +559,7 @@ template <class T>
 struct GvTextItem {
   double x, y, r;
   GvColor c;
-  std::string text;
+  int id;  // index of the text in the string table
 
   template <typename Writer>
   void WriteTo(Writer& w) {
@@ -185,7 +567,7 @@ struct GvTextItem {
     w.Write(y);
     w.Write(r);
     w.Write(c);
-    w.Write(text);
+    w.Write(id);
   }
 
   template <typename Reader>
@@ -194,7 +576,7 @@ struct GvTextItem {
     r.Read(dst.y);
     r.Read(dst.r);
     r.Read(dst.c);
-    r.Read(dst.text);
+    r.Read(dst.id);
   }
 
   T minx = std::numeric_limits<T>::max();
@@ -209,13 +591,443 @@ struct GvTextItem {
 
   void Render(const RenderArgs<T>& r) {
     int w, h;
-    TTF_SizeText(r.font, text.c_str(), &w, &h);
+    if (!r.text_size_func(id, &w, &h)) return;
     double scale = this->r / h;
     minx = std::round(this->x - w * scale * 0.5);
     maxx = std::round(this->x + w * scale * 0.5);
     miny = std::round(this->y - h * scale * 0.5);
     maxy = std::round(this->y + h * scale * 0.5);
-    r.render_text_func(x, y, this->r, 0, 0, c, text.c_str());
+    r.render_text_func(x, y, this->r, 0, 0, c, id);
+  }
+};
+
+// Density of many points binned into a grid, drawn as one color-mapped
+// image. Each cell keeps a log-scaled level, 0 for no points.
+template <class T>
+struct GvDensityItem {
+  T x, y, w, h;
+  int grid_w, grid_h;
+  uint8_t alpha;
+  std::vector<uint8_t> levels;
+
+  T MinX() const { return x; }
+  T MinY() const { return y; }
+  T MaxX() const { return x + w; }
+  T MaxY() const { return y + h; }
+
+  template <typename Writer>
+  void WriteTo(Writer& wr) {
+    wr.Write(x);
+    wr.Write(y);
+    wr.Write(w);
+    wr.Write(h);
+    wr.Write(grid_w);
+    wr.Write(grid_h);
+    wr.Write(alpha);
+    wr.WriteBytes(levels.data(), levels.size());
+  }
+
+  template <typename Reader>
+  static void ReadFrom(Reader& r, GvDensityItem& dst) {
+    r.Read(dst.x);
+    r.Read(dst.y);
+    r.Read(dst.w);
+    r.Read(dst.h);
+    r.Read(dst.grid_w);
+    r.Read(dst.grid_h);
+    r.Read(dst.alpha);
+    dst.levels.resize(static_cast<size_t>(dst.grid_w) * dst.grid_h);
+    r.ReadBytes(dst.levels.data(), dst.levels.size());
+  }
+
+  // Counts the points in each cell of counts, which has grid_w * grid_h + 1
+  // entries; the last one counts the points outside of the grid. The index
+  // computation has no branches so that the compiler can vectorize it.
+  void Bin(const double* xs, const double* ys, size_t n,
+           uint32_t* counts) const {
+    const double x0 = x;
+    const double y0 = y;
+    const double sx = grid_w / w;
+    const double sy = grid_h / h;
+    const int stride = grid_w;
+    const double gw = grid_w;
+    const double gh = grid_h;
+    const unsigned width = grid_w;
+    const unsigned height = grid_h;
+    const int outside = grid_w * grid_h;
+    constexpr size_t kChunk = 1024;
+    int index[kChunk];
+    for (size_t begin = 0; begin < n; begin += kChunk) {
+      const size_t m = std::min(kChunk, n - begin);
+      const double* px = xs + begin;
+      const double* py = ys + begin;
+      for (size_t i = 0; i < m; ++i) {
+        double fx = (px[i] - x0) * sx;
+        double fy = (py[i] - y0) * sy;
+        // Also maps NaN to -1 before the conversion to int.
+        fx = fx > -1.0 ? fx : -1.0;
+        fy = fy > -1.0 ? fy : -1.0;
+        fx = fx < gw ? fx : gw;
+        fy = fy < gh ? fy : gh;
+        const int ix = static_cast<int>(fx + 1.0) - 1;
+        const int iy = static_cast<int>(fy + 1.0) - 1;
+        const bool inside = (static_cast<unsigned>(ix) < width) &
+                            (static_cast<unsigned>(iy) < height);
+        index[i] = inside ? iy * stride + ix : outside;
+      }
+      for (size_t i = 0; i < m; ++i) ++counts[index[i]];
+    }
+  }
+
+  void SetLevels(const uint32_t* counts) {
+    const size_t cells = static_cast<size_t>(grid_w) * grid_h;
+    const uint32_t max_count = *std::max_element(counts, counts + cells);
+    levels.resize(cells);
+    const double scale = max_count > 1 ? 254.0 / std::log(max_count) : 0.0;
+    for (size_t i = 0; i < cells; ++i) {
+      if (counts[i] == 0) {
+        levels[i] = 0;
+      } else if (max_count > 1) {
+        levels[i] = 1 + std::lround(std::log(counts[i]) * scale);
+      } else {
+        levels[i] = 255;
+      }
+    }
+  }
+
+  // Colors the levels into a texture, which Render draws. The renderer keeps
+  // it while the page is shown.
+  GLuint CreateTexture() {
+    static const uint8_t stops[5][3] = {{68, 1, 84},
+                                        {59, 82, 139},
+                                        {33, 145, 140},
+                                        {94, 201, 98},
+                                        {253, 231, 37}};
+    const int tw = next_power_of_two(grid_w);
+    const int th = next_power_of_two(grid_h);
+    rgba.assign(static_cast<size_t>(tw) * th * 4, 0);
+    for (int iy = 0; iy < grid_h; ++iy) {
+      for (int ix = 0; ix < grid_w; ++ix) {
+        const int level = levels[iy * grid_w + ix];
+        if (level == 0) continue;
+        const double t = (level - 1) / 254.0 * 4;
+        const int k = std::min(static_cast<int>(t), 3);
+        const double f = t - k;
+        uint8_t* dst = &rgba[(static_cast<size_t>(iy) * tw + ix) * 4];
+        for (int ch = 0; ch < 3; ++ch) {
+          dst[ch] = std::lround(stops[k][ch] * (1 - f) + stops[k + 1][ch] * f);
+        }
+        dst[3] = alpha;
+      }
+    }
+
+    GLuint tex;
+    glGenTextures(1, &tex);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, rgba.data());
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return tex;
+  }
+
+  void Render(GLuint tex) const {
+    const int tw = next_power_of_two(grid_w);
+    const int th = next_power_of_two(grid_h);
+    const double tx = static_cast<double>(grid_w) / tw;
+    const double ty = static_cast<double>(grid_h) / th;
+    glColor4f(1, 1, 1, 1);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glEnable(GL_TEXTURE_2D);
+    glBegin(GL_QUADS);
+    {
+      glTexCoord2d(0, 0);
+      glVertex2d(x, y);
+      glTexCoord2d(tx, 0);
+      glVertex2d(x + w, y);
+      glTexCoord2d(tx, ty);
+      glVertex2d(x + w, y + h);
+      glTexCoord2d(0, ty);
+      glVertex2d(x, y + h);
+    }
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  std::vector<uint8_t> rgba;
+};
+
+// One conversion specification of a printf format, e.g. "%-8.*lld".
+struct GvFormatSpec {
+  enum Kind {
+    kPercent,
+    kInt,
+    kUInt,
+    kChar,
+    kDouble,
+    kString,
+    kPointer,
+    kUnsupported
+  };
+  Kind kind;
+  const char* body_begin;  // flags, width and precision
+  const char* body_end;
+  const char* end;  // one past the conversion character
+  char length[3];
+  int stars;
+
+  // p points to '%'.
+  static GvFormatSpec Parse(const char* p) {
+    GvFormatSpec spec;
+    spec.stars = 0;
+    spec.body_begin = ++p;
+    while (*p && strchr("-+ #0'", *p)) ++p;
+    if (*p == '*') {
+      ++spec.stars;
+      ++p;
+    }
+    while ('0' <= *p && *p <= '9') ++p;
+    if (*p == '.') {
+      ++p;
+      if (*p == '*') {
+        ++spec.stars;
+        ++p;
+      }
+      while ('0' <= *p && *p <= '9') ++p;
+    }
+    spec.body_end = p;
+    int n = 0;
+    while (*p && n < 2 && strchr("hljztL", *p)) spec.length[n++] = *p++;
+    spec.length[n] = '\0';
+    const char conv = *p;
+    spec.end = conv ? p + 1 : p;
+    const bool no_length = n == 0;
+    if (conv == '%') {
+      spec.kind = kPercent;
+    } else if (conv == 'd' || conv == 'i') {
+      spec.kind = spec.length[0] == 'L' ? kUnsupported : kInt;
+    } else if (conv && strchr("uoxX", conv)) {
+      spec.kind = spec.length[0] == 'L' ? kUnsupported : kUInt;
+    } else if (conv == 'c') {
+      spec.kind = no_length ? kChar : kUnsupported;
+    } else if (conv && strchr("fFeEgGaA", conv)) {
+      spec.kind = no_length || !strcmp(spec.length, "l") ||
+                          !strcmp(spec.length, "L")
+                      ? kDouble
+                      : kUnsupported;
+    } else if (conv == 's') {
+      spec.kind = no_length ? kString : kUnsupported;
+    } else if (conv == 'p') {
+      spec.kind = no_length ? kPointer : kUnsupported;
+    } else {
+      spec.kind = kUnsupported;
+    }
+    return spec;
+  }
+
+  // Returns false if some conversion in format can not be deferred.
+  static bool Deferrable(const char* format) {
+    for (const char* p = strchr(format, '%'); p; p = strchr(p, '%')) {
+      const GvFormatSpec spec = Parse(p);
+      if (spec.kind == kUnsupported) return false;
+      p = spec.end;
+    }
+    return true;
+  }
+
+  // Stores the arguments of a deferrable format in binary form.
+  template <typename Writer>
+  static void WriteArgs(const char* format, va_list arg, Writer& w) {
+    for (const char* p = strchr(format, '%'); p; p = strchr(p, '%')) {
+      const GvFormatSpec spec = Parse(p);
+      p = spec.end;
+      for (int i = 0; i < spec.stars; ++i) w.Write(va_arg(arg, int));
+      const std::string length = spec.length;
+      switch (spec.kind) {
+        case kInt: {
+          long long v;
+          if (length == "hh") {
+            v = static_cast<signed char>(va_arg(arg, int));
+          } else if (length == "h") {
+            v = static_cast<short>(va_arg(arg, int));
+          } else if (length == "l") {
+            v = va_arg(arg, long);
+          } else if (length == "ll") {
+            v = va_arg(arg, long long);
+          } else if (length == "j") {
+            v = va_arg(arg, intmax_t);
+          } else if (length == "z" || length == "t") {
+            v = va_arg(arg, ptrdiff_t);
+          } else {
+            v = va_arg(arg, int);
+          }
+          w.Write(v);
+          break;
+        }
+        case kUInt: {
+          unsigned long long v;
+          if (length == "hh") {
+            v = static_cast<unsigned char>(va_arg(arg, unsigned));
+          } else if (length == "h") {
+            v = static_cast<unsigned short>(va_arg(arg, unsigned));
+          } else if (length == "l") {
+            v = va_arg(arg, unsigned long);
+          } else if (length == "ll") {
+            v = va_arg(arg, unsigned long long);
+          } else if (length == "j") {
+            v = va_arg(arg, uintmax_t);
+          } else if (length == "z" || length == "t") {
+            v = va_arg(arg, size_t);
+          } else {
+            v = va_arg(arg, unsigned);
+          }
+          w.Write(v);
+          break;
+        }
+        case kChar:
+          w.Write(va_arg(arg, int));
+          break;
+        case kDouble:
+          w.Write(length == "L" ? static_cast<double>(va_arg(arg, long double))
+                                : va_arg(arg, double));
+          break;
+        case kString: {
+          const char* s = va_arg(arg, const char*);
+          w.Write(std::string(s ? s : "(null)"));
+          break;
+        }
+        case kPointer:
+          w.Write(reinterpret_cast<uintptr_t>(va_arg(arg, void*)));
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  // Formats the arguments written by WriteArgs. The result is truncated to
+  // max_size bytes like vsnprintf.
+  template <typename Reader>
+  static void Format(const char* format, Reader& r, size_t max_size,
+                     std::string& out) {
+    out.clear();
+    char buf[256];
+    std::string conv;
+    const char* p = format;
+    for (const char* q = strchr(p, '%'); q; q = strchr(p, '%')) {
+      out.append(p, q);
+      const GvFormatSpec spec = Parse(q);
+      p = spec.end;
+      if (spec.kind == kPercent) {
+        out.push_back('%');
+        continue;
+      }
+      conv = "%";
+      for (const char* b = spec.body_begin; b != spec.body_end; ++b) {
+        if (*b == '*') {
+          int v;
+          r.Read(v);
+          conv += std::to_string(v);
+        } else {
+          conv.push_back(*b);
+        }
+      }
+      if (spec.kind == kInt || spec.kind == kUInt) conv += "ll";
+      conv.push_back(spec.end[-1]);
+      int size = 0;
+      switch (spec.kind) {
+        case kInt: {
+          long long v;
+          r.Read(v);
+          size = snprintf(buf, sizeof(buf), conv.c_str(), v);
+          break;
+        }
+        case kUInt: {
+          unsigned long long v;
+          r.Read(v);
+          size = snprintf(buf, sizeof(buf), conv.c_str(), v);
+          break;
+        }
+        case kChar: {
+          int v;
+          r.Read(v);
+          size = snprintf(buf, sizeof(buf), conv.c_str(), v);
+          break;
+        }
+        case kDouble: {
+          double v;
+          r.Read(v);
+          size = snprintf(buf, sizeof(buf), conv.c_str(), v);
+          break;
+        }
+        case kString: {
+          std::string v;
+          r.Read(v);
+          size = snprintf(buf, sizeof(buf), conv.c_str(), v.c_str());
+          break;
+        }
+        case kPointer: {
+          uintptr_t v;
+          r.Read(v);
+          size = snprintf(buf, sizeof(buf), conv.c_str(),
+                          reinterpret_cast<void*>(v));
+          break;
+        }
+        default:
+          break;
+      }
+      if (size > 0) out.append(buf, std::min<size_t>(size, sizeof(buf) - 1));
+      if (out.size() >= max_size) break;
+    }
+    if (out.size() < max_size) out.append(p);
+    if (out.size() > max_size) out.resize(max_size);
+  }
+};
+
+// Text whose formatting is deferred until it is rendered.
+template <class T>
+struct GvFormatTextItem {
+  double x, y, r;
+  GvColor c;
+  int format_id;  // index of the format in the string table
+  std::vector<char> args;
+
+  template <typename Writer>
+  void WriteTo(Writer& w) {
+    w.Write(x);
+    w.Write(y);
+    w.Write(r);
+    w.Write(c);
+    w.Write(format_id);
+    w.Write(args);
+  }
+
+  template <typename Reader>
+  static void ReadFrom(Reader& r, GvFormatTextItem& dst) {
+    r.Read(dst.x);
+    r.Read(dst.y);
+    r.Read(dst.r);
+    r.Read(dst.c);
+    r.Read(dst.format_id);
+    r.Read(dst.args);
+  }
+
+  GvTextItem<T> text;
+
+  T MinX() const { return text.MinX(); }
+  T MinY() const { return text.MinY(); }
+  T MaxX() const { return text.MaxX(); }
+  T MaxY() const { return text.MaxY(); }
+
+  void Render(const RenderArgs<T>& r) {
+    text.x = x;
+    text.y = y;
+    text.r = this->r;
+    text.c = c;
+    text.id = r.format_text_func(format_id, args);
+    text.Render(r);
   }
 };
 
@@ -231,7 +1043,7 @@ struct GvCircleItem {
   T MaxY() const { return -p.y + r; }
 
   void Render(const RenderArgs<T>& r) const {
-    const auto n = 64;
+    const auto n = r.coarse ? 12 : 64;
     glColor4f(c.r / 256.0, c.g / 256.0, c.b / 256.0, c.a / 256.0);
     glBegin(GL_POLYGON);
     for (int i = 0; i < n; i++) {
@@ -244,6 +1056,349 @@ struct GvCircleItem {
   }
 };
 
+// Values of a time series, appended in O(1) amortized time. levels[k][i]
+// holds the minimum and maximum of values[i << (k + 1), (i + 1) << (k + 1)),
+// so the range of any span is found in O(log n) without reading the values.
+// values[i] is the sample base + i; NaN marks samples that were lost.
+template <class T>
+struct GvSeries {
+  std::string name;
+  GvColor color;
+  size_t base = 0;
+  std::vector<T> values;
+  std::vector<std::vector<std::pair<T, T>>> levels;
+  // (page serial, sample count) for the pages flushed after the series grew.
+  std::vector<std::pair<uint64_t, size_t>> marks;
+  bool dirty = false;
+
+  size_t end() const { return base + values.size(); }
+
+  void Append(T v) {
+    values.push_back(v);
+    size_t n = values.size();
+    if (n % 2 != 0) return;
+    std::pair<T, T> m(Min(values[n - 2], v), Max(values[n - 2], v));
+    for (size_t k = 0;; ++k) {
+      if (levels.size() == k) levels.emplace_back();
+      auto& level = levels[k];
+      level.push_back(m);
+      n = level.size();
+      if (n % 2 != 0) break;
+      m = std::make_pair(Min(level[n - 2].first, m.first),
+                         Max(level[n - 2].second, m.second));
+    }
+  }
+
+  // Minimum and maximum of the samples [begin, end). Both are NaN if the
+  // span has no valid sample.
+  void Range(size_t begin, size_t end, T* lo, T* hi) const {
+    *lo = *hi = std::numeric_limits<T>::quiet_NaN();
+    begin -= base;
+    end -= base;
+    while (begin < end) {
+      int k = -1;
+      while (k + 1 < static_cast<int>(levels.size())) {
+        const size_t size = size_t(2) << (k + 1);
+        if (begin % size != 0 || begin + size > end ||
+            (begin / size) >= levels[k + 1].size()) {
+          break;
+        }
+        ++k;
+      }
+      if (k < 0) {
+        *lo = Min(*lo, values[begin]);
+        *hi = Max(*hi, values[begin]);
+        ++begin;
+      } else {
+        const auto& m = levels[k][begin >> (k + 1)];
+        *lo = Min(*lo, m.first);
+        *hi = Max(*hi, m.second);
+        begin += size_t(2) << k;
+      }
+    }
+  }
+
+  // Number of samples shown with the page of the given serial.
+  size_t CountAt(uint64_t serial) const {
+    auto it = std::upper_bound(
+        marks.begin(), marks.end(), std::make_pair(serial, ~size_t(0)));
+    return it == marks.begin() ? 0 : std::prev(it)->second;
+  }
+
+  void Clear() {
+    base = 0;
+    values.clear();
+    levels.clear();
+    marks.clear();
+    dirty = false;
+  }
+
+  static T Min(T a, T b) { return b < a || std::isnan(a) ? b : a; }
+  static T Max(T a, T b) { return b > a || std::isnan(a) ? b : a; }
+};
+
+// Ring buffer of records in POSIX shared memory, written by one producer
+// process and read by a viewer process. The producer never waits: when the
+// ring is full the oldest records are overwritten, and a reader detects it by
+// checking the tail after it has consumed a record in place.
+class GvShmRing {
+ public:
+  enum Kind : uint32_t { kWrap = 0, kPage = 1, kStrings = 2, kSeries = 3 };
+
+  struct Record {
+    uint64_t pos;
+    uint32_t kind;
+    const char* data;
+    size_t size;
+  };
+
+  ~GvShmRing() { Close(); }
+
+  // Creates or takes over the ring as the producer.
+  bool Create(const char* name, size_t capacity) {
+    capacity = Align(capacity);
+    const size_t size = sizeof(Header) + capacity;
+    const int fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) return false;
+    struct stat st;
+    // Never shrink the object, a viewer may still have it mapped.
+    if (fstat(fd, &st) != 0 ||
+        (static_cast<size_t>(st.st_size) < size && ftruncate(fd, size) != 0)) {
+      close(fd);
+      return false;
+    }
+    if (!Map(fd, size)) return false;
+
+    const bool reuse = header_->magic == kMagic &&
+                       header_->version == kVersion &&
+                       header_->capacity == capacity;
+    const uint64_t generation = header_->magic == kMagic
+                                    ? header_->generation.load() + 1
+                                    : 1;
+    if (reuse) {
+      header_->tail.store(header_->head.load());
+    } else {
+      header_->magic = kMagic;
+      header_->version = kVersion;
+      header_->capacity = capacity;
+      header_->head.store(0);
+      header_->tail.store(0);
+      header_->resync.store(0);
+      header_->read_pos.store(0);
+      header_->heartbeat_ms.store(0);
+    }
+    resync_seen_ = header_->resync.load();
+    capacity_ = capacity;
+    header_->generation.store(generation, std::memory_order_release);
+    return true;
+  }
+
+  // Opens an existing ring as a reader, starting at the oldest record.
+  bool Open(const char* name) {
+    const int fd = shm_open(name, O_RDWR, 0600);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(Header)) {
+      close(fd);
+      return false;
+    }
+    if (!Map(fd, st.st_size)) return false;
+    generation_ = header_->generation.load(std::memory_order_acquire);
+    if (header_->magic != kMagic || header_->version != kVersion ||
+        sizeof(Header) + header_->capacity > size_) {
+      Close();
+      return false;
+    }
+    // A producer that restarts may change the capacity in the header. The
+    // reader keeps using its own until producer_changed makes it reopen.
+    capacity_ = header_->capacity;
+    pos_ = header_->tail.load(std::memory_order_acquire);
+    lost_ = 0;
+    return true;
+  }
+
+  // Removes the shared memory object. Processes that have it open keep it
+  // until they close it.
+  static void Unlink(const char* name) { shm_unlink(name); }
+
+  void Close() {
+    if (header_ != nullptr) munmap(header_, size_);
+    header_ = nullptr;
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+  }
+
+  bool is_open() const { return header_ != nullptr; }
+
+  // Appends a record, overwriting the oldest ones if needed. Returns false if
+  // the record does not fit in half of the ring.
+  bool Write(uint32_t kind, const char* data, size_t size) {
+    const uint64_t cap = capacity_;
+    const uint64_t need = sizeof(RecordHeader) + Align(size);
+    if (need > cap / 2) return false;
+    uint64_t pos = header_->head.load(std::memory_order_relaxed);
+    uint64_t pad = cap - pos % cap;
+    if (need <= pad) pad = 0;
+    Reserve(pos + pad + need);
+    if (pad) {
+      RecordHeader h = {0, kWrap};
+      memcpy(data_ + pos % cap, &h, sizeof(h));
+      pos += pad;
+    }
+    RecordHeader h = {static_cast<uint32_t>(size), kind};
+    char* dst = data_ + pos % cap;
+    memcpy(dst, &h, sizeof(h));
+    memcpy(dst + sizeof(h), data, size);
+    header_->head.store(pos + need, std::memory_order_release);
+    return true;
+  }
+
+  // True once for each RequestResync of a reader.
+  bool resync_requested() {
+    const uint64_t r = header_->resync.load(std::memory_order_relaxed);
+    if (r == resync_seen_) return false;
+    resync_seen_ = r;
+    return true;
+  }
+
+  // Points rec at the next record without copying it. The record must be
+  // checked with Valid after it has been consumed.
+  bool Next(Record* rec) {
+    const uint64_t cap = capacity_;
+    const uint64_t head = header_->head.load(std::memory_order_acquire);
+    while (pos_ < head) {
+      if (producer_changed()) return false;
+      if (pos_ < header_->tail.load(std::memory_order_acquire)) {
+        pos_ = header_->tail.load(std::memory_order_acquire);
+        ++lost_;
+        continue;
+      }
+      RecordHeader h;
+      memcpy(&h, data_ + pos_ % cap, sizeof(h));
+      const Record r = {pos_, h.kind, data_ + pos_ % cap + sizeof(h), h.size};
+      if (!Valid(r)) continue;
+      // Only a producer that has restarted writes records which cross the
+      // end of the ring; never read past the mapping for them.
+      if (sizeof(h) + Align(h.size) > cap - pos_ % cap) return false;
+      if (h.kind == kWrap) {
+        pos_ += cap - pos_ % cap;
+        continue;
+      }
+      pos_ += sizeof(h) + Align(h.size);
+      *rec = r;
+      return true;
+    }
+    return false;
+  }
+
+  // False if the producer may have overwritten rec while it was read.
+  bool Valid(const Record& rec) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return header_->tail.load(std::memory_order_relaxed) <= rec.pos;
+  }
+
+  // Asks the producer to send everything a new reader needs again.
+  void RequestResync() {
+    header_->resync.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // True if another producer has taken over the ring since Open.
+  bool producer_changed() const {
+    return header_->generation.load(std::memory_order_acquire) != generation_;
+  }
+
+  uint64_t lost() const { return lost_; }
+
+  // Tells the producer how far the reader has read.
+  void Heartbeat() {
+    header_->read_pos.store(pos_, std::memory_order_relaxed);
+    header_->heartbeat_ms.store(NowMs(), std::memory_order_relaxed);
+  }
+
+  uint64_t head() const {
+    return header_->head.load(std::memory_order_relaxed);
+  }
+  uint64_t tail() const {
+    return header_->tail.load(std::memory_order_relaxed);
+  }
+  uint64_t capacity() const { return capacity_; }
+  uint64_t read_pos() const {
+    return header_->read_pos.load(std::memory_order_relaxed);
+  }
+
+  // True if a reader has called Heartbeat within the last second.
+  bool reader_alive() const {
+    return NowMs() - header_->heartbeat_ms.load(std::memory_order_relaxed) <
+           1000;
+  }
+
+ private:
+  static constexpr uint32_t kMagic = 0x53564721;  // "!GVS"
+  static constexpr uint32_t kVersion = 4;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> head;  // bytes written so far
+    std::atomic<uint64_t> tail;  // position of the oldest valid record
+    std::atomic<uint64_t> resync;
+    std::atomic<uint64_t> read_pos;      // position the reader has read to
+    std::atomic<int64_t> heartbeat_ms;  // when the reader last read
+  };
+
+  struct RecordHeader {
+    uint32_t size;
+    uint32_t kind;
+  };
+
+  Header* header_ = nullptr;
+  char* data_ = nullptr;
+  size_t size_ = 0;
+  uint64_t capacity_ = 0;
+  uint64_t generation_ = 0;
+  uint64_t pos_ = 0;
+  uint64_t lost_ = 0;
+  uint64_t resync_seen_ = 0;
+
+  static uint64_t Align(uint64_t n) { return (n + 7) & ~uint64_t(7); }
+
+  // steady_clock is system wide, so it can be compared between processes.
+  static int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  bool Map(int fd, size_t size) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+    header_ = static_cast<Header*>(p);
+    data_ = static_cast<char*>(p) + sizeof(Header);
+    size_ = size;
+    return true;
+  }
+
+  // Moves the tail past the records that end will overwrite.
+  void Reserve(uint64_t end) {
+    const uint64_t cap = capacity_;
+    uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+    const uint64_t old_tail = tail;
+    while (end - tail > cap) {
+      RecordHeader h;
+      memcpy(&h, data_ + tail % cap, sizeof(h));
+      tail += h.kind == kWrap ? cap - tail % cap : sizeof(h) + Align(h.size);
+    }
+    if (tail == old_tail) return;
+    header_->tail.store(tail, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+};
+
 class GvSDL {
  public:
   GvColor Color(int8_t r = 0, uint8_t g = 0, uint8_t b = 0,
@@ -272,16 +1427,26 @@ class GvSDL {
     mtx.unlock();
   }
 
-  void NewTime() {
-    if (!enabled()) return;
+  // Starts a new page. Returns false if the page will not be kept because of
+  // the sampling settings; the drawing calls are ignored until the next
+  // NewTime, so the caller can skip them.
+  bool NewTime() {
+    if (!enabled()) return false;
     mtx.lock();
     FlushLocked();
-    buffer.push_back('n');
-    BinaryWriter(buffer).Write(buffer_time);
+    recording_ = SampleLocked();
+    if (recording_) {
+      buffer.push_back('n');
+      BinaryWriter(buffer).Write(buffer_time);
+    }
     buffer_time += 1.0;
     mtx.unlock();
+    return recording_;
   }
 
+  // True if the current page is kept. Same as the last result of NewTime.
+  bool recording() const { return enabled() && recording_; }
+
   void RunMainThread(std::function<void()> f) {
     if (!enabled()) {
       f();
@@ -289,7 +1454,13 @@ class GvSDL {
     }
     Init();
     initialized = true;
-    auto th = std::thread(f);
+    auto th = std::thread([this, f] {
+      f();
+      mtx.lock();
+      producer_done_ = true;
+      mtx.unlock();
+      first_page_cv.notify_all();
+    });
     th.detach();
     MainLoop();
   }
@@ -302,9 +1473,39 @@ class GvSDL {
     th.detach();
   }
 
+  // Sends pages to a viewer process (RunViewer) through the POSIX shared
+  // memory object name instead of opening a window. The producer never waits
+  // for the viewer; old pages are overwritten when the ring is full.
+  void RunSharedMemory(const char* name = "/gv", size_t capacity = 64 << 20) {
+    if (!enabled()) return;
+    if (initialized) return;
+    if (!shm.Create(name, capacity)) {
+      std::cerr << "failed to open shared memory " << name << std::endl;
+      enabled(false);
+      return;
+    }
+    InitBuffer();
+    initialized = true;
+  }
+
+  // Opens a window which shows the pages written by RunSharedMemory in
+  // another process. Waits for the producer and follows it when it restarts.
+  void RunViewer(const char* name = "/gv") {
+    if (!enabled()) return;
+    if (initialized) return;
+    shm_name_ = name;
+    startup_begin_ = std::chrono::steady_clock::now();
+    initialized = true;
+    MainLoop();
+  }
+
+  // The shared memory object stays in /dev/shm after both processes exit so
+  // that either can restart. Removes it.
+  void RemoveSharedMemory(const char* name = "/gv") { GvShmRing::Unlink(name); }
+
   void Line(double x1, double y1, double x2, double y2, double r,
             GvColor color) {
-    if (!enabled()) return;
+    if (!recording()) return;
     constexpr double sqrt2 = 1.41421356237;
     const double odx = x2 - x1;
     const double ody = y2 - y1;
@@ -335,7 +1536,7 @@ class GvSDL {
   }
 
   void Circle(double x, double y, double r, GvColor color) {
-    if (!enabled()) return;
+    if (!recording()) return;
     GvCircleItem<double> item;
     item.p.x = x;
     item.p.y = y;
@@ -347,7 +1548,7 @@ class GvSDL {
   }
 
   void Rect(double x, double y, double w, double h, GvColor color) {
-    if (!enabled()) return;
+    if (!recording()) return;
     GvPolygonItem<double> item;
     item.vx.push_back(x);
     item.vx.push_back(x);
@@ -363,12 +1564,106 @@ class GvSDL {
     item.WriteTo(wr);
   }
 
+  // Bins n points (xs[i], ys[i]) into a grid_w x grid_h grid over the
+  // rectangle (x, y, w, h) and draws the density as one image, so the cost of
+  // the page depends on the grid instead of the number of points. With
+  // threads > 1 the points are binned in parallel.
+  void Density(double x, double y, double w, double h, int grid_w, int grid_h,
+               const double* xs, const double* ys, size_t n,
+               int threads = 1) {
+    if (!recording()) return;
+    if (grid_w <= 0 || grid_h <= 0 || !(w > 0) || !(h > 0)) return;
+    GvDensityItem<double> item;
+    item.x = x;
+    item.y = y;
+    item.w = w;
+    item.h = h;
+    item.grid_w = grid_w;
+    item.grid_h = grid_h;
+    item.alpha = default_alpha();
+
+    const size_t cells = static_cast<size_t>(grid_w) * grid_h + 1;
+    constexpr size_t kMinPointsPerThread = 1 << 16;
+    threads = static_cast<int>(
+        std::min<size_t>(std::max(threads, 1), n / kMinPointsPerThread + 1));
+    std::vector<uint32_t> counts(cells * threads);
+    if (threads == 1) {
+      item.Bin(xs, ys, n, counts.data());
+    } else {
+      std::vector<std::thread> workers;
+      const size_t chunk = (n + threads - 1) / threads;
+      for (int t = 0; t < threads; ++t) {
+        const size_t begin = std::min(n, chunk * t);
+        const size_t m = std::min(n, begin + chunk) - begin;
+        workers.emplace_back([&item, &counts, xs, ys, begin, m, cells, t] {
+          item.Bin(xs + begin, ys + begin, m, &counts[cells * t]);
+        });
+      }
+      for (auto& worker : workers) worker.join();
+      for (int t = 1; t < threads; ++t) {
+        for (size_t i = 0; i < cells; ++i) counts[i] += counts[cells * t + i];
+      }
+    }
+    item.SetLevels(counts.data());
+
+    auto wr = BinaryWriter(buffer);
+    buffer.push_back('d');
+    item.WriteTo(wr);
+  }
+
+  // Fills a polygon with n vertices (xs[i], ys[i]). It may be concave.
+  void Polygon(const double* xs, const double* ys, size_t n, GvColor color) {
+    Polygon(xs, ys, &n, 1, color);
+  }
+
+  // Fills a polygon with holes. The first sizes[0] points of xs, ys are the
+  // outline, and each of the next sizes[k] points are a hole.
+  void Polygon(const double* xs, const double* ys, const size_t* sizes,
+               size_t rings, GvColor color) {
+    if (!recording()) return;
+    if (rings == 0 || sizes[0] < 3) return;
+    auto wr = BinaryWriter(buffer);
+    buffer.push_back('P');
+    GvShapeItem<double>::Write(wr, xs, ys, sizes, rings, color);
+  }
+
+  // Draws lines through n points (xs[i], ys[i]), as wide as Line. If closed,
+  // the last point is connected to the first.
+  void Polyline(const double* xs, const double* ys, size_t n, double r,
+                GvColor color, bool closed = false) {
+    if (!recording()) return;
+    if (n < 2) return;
+    auto wr = BinaryWriter(buffer);
+    buffer.push_back('l');
+    GvPolylineItem<double>::Write(wr, xs, ys, n, r, closed, color);
+  }
+
   void Text(double x, double y, double r, GvColor color,
             const char* format = "?", ...) {
-    if (!enabled()) return;
-    char buf[256];
+    if (!recording()) return;
     va_list arg;
     va_start(arg, format);
+    if (deferred_text()) {
+      const int format_id = FormatId(format);
+      if (format_id >= 0) {
+        GvFormatTextItem<double>& item = deferred_text_item;
+        item.x = x;
+        item.y = y;
+        item.r = r;
+        item.c = color;
+        item.format_id = format_id;
+        if (shm.is_open()) page_string_ids.push_back(format_id);
+        item.args.clear();
+        BinaryWriter args_writer(item.args);
+        GvFormatSpec::WriteArgs(format, arg, args_writer);
+        va_end(arg);
+        auto wr = BinaryWriter(buffer);
+        buffer.push_back('f');
+        item.WriteTo(wr);
+        return;
+      }
+    }
+    char buf[256];
     auto size = vsnprintf(buf, 256, format, arg);
     va_end(arg);
     if (size < 0) return;
@@ -377,15 +1672,22 @@ class GvSDL {
     item.y = y;
     item.r = r;
     item.c = color;
-    item.text.assign(buf, size);
+    item.id = InternString(buf, std::min(size, 255));
     auto wr = BinaryWriter(buffer);
+    if (item.id < 0) {
+      buffer.push_back('T');
+      item.WriteTo(wr);
+      wr.Write(intern_key);
+      return;
+    }
     buffer.push_back('t');
     item.WriteTo(wr);
+    if (shm.is_open()) page_string_ids.push_back(item.id);
   }
 
   void Arrow(double x1, double y1, double x2, double y2, double r,
              GvColor color) {
-    if (!enabled()) return;
+    if (!recording()) return;
     constexpr double sqrt2 = 1.41421356237;
     constexpr double sinA = 0.2588190451;   // sin(M_PI * 15 / 180);
     constexpr double cosA = 0.96592582628;  // cos(M_PI * 15 / 180);
@@ -442,7 +1744,39 @@ class GvSDL {
     item.WriteTo(wr);
   }
 
-  void font_path(const char* s) { font_path_ = s; }
+  // Returns the id of the series called name, creating it on the first call.
+  // Series are kept apart from the pages and drawn as charts over the window
+  // up to the page being shown.
+  int Series(const char* name) {
+    if (!enabled()) return -1;
+    mtx.lock();
+    const int id = SeriesLocked(name);
+    mtx.unlock();
+    return id;
+  }
+
+  int Series(const char* name, GvColor color) {
+    if (!enabled()) return -1;
+    mtx.lock();
+    const int id = SeriesLocked(name);
+    series_[id].color = color;
+    mtx.unlock();
+    return id;
+  }
+
+  // Appends value to the series in O(1). It is shown from the next NewTime or
+  // Flush, also when the page is not kept.
+  void Plot(int series, double value) {
+    if (!enabled()) return;
+    if (series < 0 || series >= static_cast<int>(series_buffer.size())) return;
+    series_buffer[series].values.push_back(value);
+  }
+
+  void font_path(const char* s) {
+    mtx.lock();
+    font_path_ = s;
+    mtx.unlock();
+  }
   const std::string& font_path() const { return font_path_; }
 
   void default_alpha(uint8_t a) { default_alpha_ = a; }
@@ -451,6 +1785,77 @@ class GvSDL {
   bool enabled() const { return enabled_; }
   void enabled(bool b) { enabled_ = b; }
 
+  // Sets what Flush and NewTime do when max_pending pages are waiting for the
+  // viewer. With RunSharedMemory only kBlock has an effect, otherwise the ring
+  // overwrites the oldest pages.
+  void backpressure(GvBackpressure::Policy policy, int max_pending = 1) {
+    mtx.lock();
+    backpressure_ = policy;
+    max_pending_pages_ = std::max(max_pending, 1);
+    mtx.unlock();
+    viewed_cv.notify_all();
+  }
+  GvBackpressure::Policy backpressure() const { return backpressure_; }
+  int max_pending_pages() const { return max_pending_pages_; }
+
+  // Number of pages the viewer has not shown yet.
+  int pending_pages() {
+    mtx.lock();
+    const int n = PendingPagesLocked();
+    mtx.unlock();
+    return n;
+  }
+  uint64_t dropped_pages() const { return dropped_pages_; }
+  uint64_t coalesced_pages() const { return coalesced_pages_; }
+
+  // Keeps at most n pages per second. 0 means no limit.
+  void max_pages_per_second(double n) { max_pages_per_second_ = n; }
+  double max_pages_per_second() const { return max_pages_per_second_; }
+
+  // Keeps one page out of every n NewTime calls.
+  void sample_every(int n) { sample_every_ = std::max(n, 1); }
+  int sample_every() const { return sample_every_; }
+
+  // If true, pages are not kept while the viewer is stopped at a page by the
+  // arrow keys. Has no effect with RunSharedMemory.
+  void skip_when_paused(bool b) { skip_when_paused_ = b; }
+  bool skip_when_paused() const { return skip_when_paused_; }
+
+  // Time the viewer spends drawing a page per frame. Larger pages are drawn
+  // over several frames, first coarse and then in full detail. 0 draws the
+  // whole page every frame.
+  void render_slice_ms(double ms) { render_slice_ms_ = ms; }
+  double render_slice_ms() const { return render_slice_ms_; }
+
+  // If true, Text keeps the format and the arguments and formats them when
+  // the page is rendered. The format must stay alive and unchanged, like a
+  // string literal.
+  bool deferred_text() const { return deferred_text_; }
+  void deferred_text(bool b) { deferred_text_ = b; }
+
+  // Samples per pixel of the window. 0 disables multisampling. Takes effect
+  // when the window is created.
+  void msaa_samples(int n) { msaa_samples_ = std::max(n, 0); }
+  int msaa_samples() const { return msaa_samples_; }
+
+  // Memory for the table of texts, which pages refer to by id. Texts are
+  // never removed from it; when it is full new texts are stored in each
+  // page that uses them.
+  void max_string_table_bytes(size_t n) { max_string_table_bytes_ = n; }
+  size_t max_string_table_bytes() const { return max_string_table_bytes_; }
+
+  // Number of samples shown in each chart, ending at the page being shown.
+  // 0 shows the whole series. The [ and ] keys change it in the viewer.
+  void chart_span(size_t n) { chart_span_ = n; }
+  size_t chart_span() const { return chart_span_; }
+
+  GvStartupStats startup_stats() {
+    mtx.lock();
+    GvStartupStats stats = startup_;
+    mtx.unlock();
+    return stats;
+  }
+
  private:
   std::mutex mtx;
   std::vector<char> commands;
@@ -459,8 +1864,148 @@ class GvSDL {
   int vis_time_index = 0;
   double buffer_time = 0;
 
+  GvBackpressure::Policy backpressure_ = GvBackpressure::kKeepAll;
+  int max_pending_pages_ = 1;
+  int viewed_pages_ = 0;  // pages up to the newest one the viewer has shown
+  bool viewer_running_ = false;
+  std::condition_variable viewed_cv;
+  uint64_t dropped_pages_ = 0;
+  uint64_t coalesced_pages_ = 0;
+
+  double render_slice_ms_ = 8;
+  int msaa_samples_ = 4;
+
+  // Series. Plot writes series_buffer without the lock and FlushLocked moves
+  // the values to series_ (or to the shared memory). Each page records the
+  // serial which the series marks refer to.
+  struct PendingSeries {
+    size_t first = 0;  // index of values[0] in the series
+    std::vector<double> values;
+  };
+  std::unordered_map<std::string, int> series_ids;
+  std::vector<GvSeries<double>> series_;
+  std::vector<PendingSeries> series_buffer;
+  std::vector<int> dirty_series;
+  std::vector<uint64_t> page_serials;  // same size as time_index
+  uint64_t page_serial_ = 0;
+  size_t chart_span_ = 0;
+  bool show_charts_ = true;
+
+  // The window is created when the first page is flushed, or when the
+  // function given to RunMainThread returns without flushing.
+  std::condition_variable first_page_cv;
+  bool producer_done_ = false;
+  std::chrono::steady_clock::time_point startup_begin_;
+  GvStartupStats startup_;
+  bool startup_reported_ = false;
+
+  // The font is opened in another thread. Text is not drawn until it is done.
+  std::future<TTF_Font*> font_future_;
+  std::string font_failed_path_;
+
+  uint64_t pages_version_ = 0;  // changes when drawn pages move or reset
+  int shown_page_ = -1;         // page drawn by the last Render
+
+  // A page drawn over several frames. What has been drawn is kept in tex[0]
+  // and the last finished pass in tex[1].
+  struct Progress {
+    enum Pass { kCoarse, kFull, kDone };
+    int page = -1;
+    uint64_t version = 0;
+    Point<int> center;
+    double zoom = 0;
+    int width = 0, height = 0;
+    bool font = false;
+    BoundingBox<double> box;
+    size_t begin = 0, pos = 0, end = 0;
+    int pass = kCoarse;
+    bool has_finished = false;
+    GLuint tex[2] = {0, 0};
+    int tex_w = 0, tex_h = 0;
+  };
+  static constexpr size_t kCoarsePageBytes = 1 << 20;
+  Progress progress;
+
+  // Triangles of the polygon commands in [start, built_until) of the page
+  // ending at end, so that a page is triangulated once and drawn with a few
+  // vertex array calls. Entries are in command order.
+  struct TriangleCache {
+    struct Entry {
+      size_t pos, next;    // command and the one after it
+      size_t first, count;  // vertices
+    };
+    uint64_t version = 0;
+    size_t start = 0, built_until = 0, end = 0;
+    std::vector<Entry> entries;
+    std::vector<double> xy;
+    std::vector<GvColor> colors;
+  };
+  TriangleCache triangles;
+  GvTriangulator<double> triangulator;
+  std::vector<double> coarse_xy;
+  std::vector<GvColor> coarse_colors;
+
+  // Textures of the density commands of the page last drawn, by position.
+  struct DensityCache {
+    uint64_t version = 0;
+    size_t end = 0;  // end of the page
+    std::unordered_map<size_t, GLuint> textures;
+  };
+  DensityCache densities;
+
+  bool recording_ = true;
+  double max_pages_per_second_ = 0;
+  int sample_every_ = 1;
+  bool skip_when_paused_ = false;
+  uint64_t new_time_count_ = 0;
+  std::chrono::steady_clock::time_point last_kept_time_;
+
+  // Texts are interned and pages refer to them by id. string_ids and
+  // string_buffer are owned by the producer, strings is shared with the
+  // renderer and only grows in FlushLocked. Strings are never removed, so
+  // once the table holds max_string_table_bytes_ new texts are written into
+  // the page instead ('T'). With shared memory the producer keeps strings too,
+  // so the limit bounds the memory of both processes.
+  std::unordered_map<std::string, int> string_ids;
+  std::vector<std::string> string_buffer;
+  std::vector<std::string> strings;
+  std::string intern_key;
+  size_t string_table_bytes_ = 0;
+  size_t max_string_table_bytes_ = 16 << 20;
+  static constexpr size_t kMaxTextTextures = 4096;
+  std::unordered_map<int, GvTextTexture> text_textures;
+
+  // Formats of deferred texts, keyed by pointer. -1 means the format has a
+  // conversion which can not be deferred.
+  std::unordered_map<const char*, int> format_ids;
+  GvFormatTextItem<double> deferred_text_item;
+
+  // Texts formatted by the renderer or written into the page. They get
+  // negative ids, -1 - index.
+  static constexpr size_t kMaxFormattedTexts = 4096;
+  std::unordered_map<std::string, int> formatted_ids;
+  std::vector<std::string> formatted_strings;
+  std::string formatted_text;
+  std::string inline_text;
+
+  GvShmRing shm;
+  std::string shm_name_;  // set in the viewer process
+  std::vector<char> shm_scratch;
+  std::deque<uint64_t> shm_page_ends;  // pages the viewer has not read
+  // Strings used by each page still in the ring, so that a resync sends only
+  // those. string_sent_ is the resync epoch in which each string was sent.
+  struct ShmPageStrings {
+    uint64_t end;
+    std::vector<int> string_ids;
+  };
+  std::deque<ShmPageStrings> shm_live_pages;
+  std::vector<int> page_string_ids;  // owned by the producer
+  std::vector<uint32_t> string_sent_;
+  uint32_t string_epoch_ = 1;
+
   bool initialized = false;
   bool enabled_ = true;
+  bool deferred_text_ = false;
   SDL_Window* window = nullptr;
   SDL_Renderer* renderer = nullptr;
   TTF_Font* font = nullptr;
@@ -476,14 +2021,25 @@ class GvSDL {
   void Init() {
     if (!enabled()) return;
     if (initialized) return;
+    InitBuffer();
+  }
+
+  void InitBuffer() {
     mtx.lock();
+    startup_begin_ = std::chrono::steady_clock::now();
     buffer_time = 0;
 
     buffer.push_back('n');
     BinaryWriter(buffer).Write(buffer_time);
     mtx.unlock();
+  }
+
+  void InitWindow() {
+    mtx.lock();
+    viewer_running_ = true;
+    mtx.unlock();
 
-    SDL_Init(SDL_INIT_EVERYTHING);
+    SDL_Init(SDL_INIT_VIDEO);
     TTF_Init();
     SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
     SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
@@ -491,8 +2047,8 @@ class GvSDL {
     SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
-    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 16);
+    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, msaa_samples_ > 0);
+    SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, msaa_samples_);
 
     center.x = 0;
     center.y = 0;
@@ -504,12 +2060,68 @@ class GvSDL {
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    mtx.lock();
+    startup_.window_ms = StartupMs();
+    mtx.unlock();
+  }
+
+  // In-process, waits until there is something to show before creating the
+  // window, so that the producer starts without waiting for SDL.
+  void OpenWindow() {
+    if (shm_name_.empty()) {
+      std::unique_lock<std::mutex> lock(mtx);
+      first_page_cv.wait(
+          lock, [this] { return !time_index.empty() || producer_done_; });
+    }
+    InitWindow();
+  }
+
+  double StartupMs() const {
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - startup_begin_;
+    return elapsed.count();
   }
 
   bool FontCheck() {
-    if (!font && !font_path().empty())
-      font = TTF_OpenFont(font_path().c_str(), 64);
-    return font != nullptr;
+    if (font != nullptr) return true;
+    if (font_future_.valid()) {
+      if (font_future_.wait_for(std::chrono::seconds(0)) !=
+          std::future_status::ready) {
+        return false;
+      }
+      font = font_future_.get();
+      mtx.lock();
+      if (font == nullptr) {
+        std::cerr << "failed to open font " << font_path_ << std::endl;
+        font_failed_path_ = font_path_;
+      } else {
+        startup_.font_ms = StartupMs();
+      }
+      mtx.unlock();
+      return font != nullptr;
+    }
+
+    mtx.lock();
+    const std::string path = font_path_;
+    mtx.unlock();
+    if (path.empty() || path == font_failed_path_) return false;
+    font_future_ = std::async(std::launch::async, [path] {
+      return TTF_OpenFont(path.c_str(), 64);
+    });
+    return false;
+  }
+
+  void ReportStartup() {
+    if (startup_reported_) return;
+    if (startup_.first_frame_ms < 0 || font_future_.valid()) return;
+    startup_reported_ = true;
+    mtx.lock();
+    const GvStartupStats s = startup_;
+    mtx.unlock();
+    std::cerr << "startup: first page " << s.first_page_ms << " ms, window "
+              << s.window_ms << " ms, first frame " << s.first_frame_ms
+              << " ms, font " << s.font_ms << " ms" << std::endl;
   }
 
   void Zoom(int direction, bool think_mouse = false) {
@@ -532,10 +2144,52 @@ class GvSDL {
     }
   }
 
+  // Returns -1 if s is new and the table is full.
+  int InternString(const char* s, size_t n) {
+    intern_key.assign(s, n);
+    auto it = string_ids.find(intern_key);
+    if (it != string_ids.end()) return it->second;
+    // Kept as the key of string_ids and in strings.
+    const size_t bytes = 2 * (sizeof(std::string) + n);
+    if (string_table_bytes_ + bytes > max_string_table_bytes_) return -1;
+    string_table_bytes_ += bytes;
+    const int id = static_cast<int>(string_ids.size());
+    string_ids.emplace(intern_key, id);
+    string_buffer.push_back(intern_key);
+    return id;
+  }
+
+  int FormatId(const char* format) {
+    auto it = format_ids.find(format);
+    if (it != format_ids.end()) return it->second;
+    const int id = GvFormatSpec::Deferrable(format)
+                       ? InternString(format, strlen(format))
+                       : -1;
+    format_ids.emplace(format, id);
+    return id;
+  }
+
   void FlushLocked() {
+    if (shm.is_open()) {
+      SendLocked();
+      return;
+    }
+    strings.insert(strings.end(),
+                   std::make_move_iterator(string_buffer.begin()),
+                   std::make_move_iterator(string_buffer.end()));
+    string_buffer.clear();
+    for (size_t i = 0; i < series_buffer.size(); ++i) {
+      auto& pending = series_buffer[i];
+      if (pending.values.empty()) continue;
+      for (double v : pending.values) series_[i].Append(v);
+      pending.first += pending.values.size();
+      pending.values.clear();
+      MarkSeriesDirtyLocked(static_cast<int>(i));
+    }
     if (buffer.empty()) {
       return;
     }
+    ApplyBackpressureLocked();
     if (auto_mode_) {
       vis_time_index = static_cast<int>(time_index.size());
     }
@@ -543,6 +2197,314 @@ class GvSDL {
     commands.insert(commands.end(), std::make_move_iterator(buffer.begin()),
                     std::make_move_iterator(buffer.end()));
     buffer.clear();
+    MarkPageLocked();
+    if (startup_.first_page_ms < 0) {
+      startup_.first_page_ms = StartupMs();
+      first_page_cv.notify_all();
+    }
+  }
+
+  // Decides whether the page started by NewTime is kept.
+  bool SampleLocked() {
+    const bool sampled = new_time_count_++ % sample_every_ == 0;
+    if (!sampled) return false;
+    if (skip_when_paused_ && !auto_mode_ && !shm.is_open()) return false;
+    if (max_pages_per_second_ > 0) {
+      const auto now = std::chrono::steady_clock::now();
+      const std::chrono::duration<double> elapsed = now - last_kept_time_;
+      if (elapsed.count() < 1.0 / max_pages_per_second_) return false;
+      last_kept_time_ = now;
+    }
+    return true;
+  }
+
+  int PendingPagesLocked() {
+    if (shm.is_open()) {
+      const uint64_t read_pos = shm.read_pos();
+      const uint64_t tail = shm.tail();
+      while (!shm_page_ends.empty() &&
+             (shm_page_ends.front() <= read_pos ||
+              shm_page_ends.front() <= tail)) {
+        if (read_pos < shm_page_ends.front()) ++dropped_pages_;
+        shm_page_ends.pop_front();
+      }
+      return static_cast<int>(shm_page_ends.size());
+    }
+    return static_cast<int>(time_index.size()) - viewed_pages_;
+  }
+
+  // Makes room for one more page the viewer has not shown.
+  void ApplyBackpressureLocked() {
+    if (backpressure_ == GvBackpressure::kKeepAll) return;
+    if (backpressure_ == GvBackpressure::kBlock) {
+      if (shm.is_open()) {
+        // The viewer is another process and cannot notify viewed_cv; polls
+        // without holding the lock.
+        while (shm.reader_alive() &&
+               backpressure_ == GvBackpressure::kBlock &&
+               PendingPagesLocked() >= max_pending_pages_) {
+          mtx.unlock();
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          mtx.lock();
+        }
+        return;
+      }
+      std::unique_lock<std::mutex> lock(mtx, std::adopt_lock);
+      viewed_cv.wait(lock, [this] {
+        return !viewer_running_ || backpressure_ != GvBackpressure::kBlock ||
+               PendingPagesLocked() < max_pending_pages_;
+      });
+      lock.release();
+      return;
+    }
+    if (shm.is_open() || PendingPagesLocked() < max_pending_pages_) return;
+    if (backpressure_ == GvBackpressure::kCoalesce) {
+      ErasePageLocked(time_index.size() - 1);
+      ++coalesced_pages_;
+    } else {
+      ErasePageLocked(viewed_pages_);
+      ++dropped_pages_;
+    }
+  }
+
+  void ErasePageLocked(size_t index) {
+    const int begin = time_index[index];
+    const int end = index + 1 < time_index.size()
+                        ? time_index[index + 1]
+                        : static_cast<int>(commands.size());
+    commands.erase(commands.begin() + begin, commands.begin() + end);
+    time_index.erase(time_index.begin() + index);
+    page_serials.erase(page_serials.begin() + index);
+    for (size_t i = index; i < time_index.size(); ++i) {
+      time_index[i] -= end - begin;
+    }
+    // Pages after the one on screen keep their offsets. The producer only
+    // erases pages the viewer has not shown, so this is the common case.
+    const int erased = static_cast<int>(index);
+    if (erased <= shown_page_) ++pages_version_;
+    if (erased < shown_page_) --shown_page_;
+    if (erased < progress.page) --progress.page;
+    if (static_cast<int>(index) < vis_time_index) --vis_time_index;
+    vis_time_index = std::max(
+        0, std::min(vis_time_index, static_cast<int>(time_index.size()) - 1));
+  }
+
+  int SeriesLocked(const char* name) {
+    constexpr int colors[] = {23, 35, 7, 21, 4, 8};
+    auto it = series_ids.find(name);
+    if (it != series_ids.end()) return it->second;
+    const int id = static_cast<int>(series_.size());
+    series_ids.emplace(name, id);
+    series_.emplace_back();
+    series_.back().name = name;
+    series_.back().color = ColorIndex(colors[id % 6]);
+    series_buffer.emplace_back();
+    return id;
+  }
+
+  void MarkSeriesDirtyLocked(int id) {
+    if (series_[id].dirty) return;
+    series_[id].dirty = true;
+    dirty_series.push_back(id);
+  }
+
+  // Called after a page is added to time_index.
+  void MarkPageLocked() {
+    for (int id : dirty_series) {
+      series_[id].marks.emplace_back(page_serial_, series_[id].end());
+      series_[id].dirty = false;
+    }
+    dirty_series.clear();
+    page_serials.push_back(page_serial_++);
+  }
+
+  // FlushLocked of the producer in RunSharedMemory.
+  void SendLocked() {
+    const bool resync = shm.resync_requested();
+    strings.insert(strings.end(),
+                   std::make_move_iterator(string_buffer.begin()),
+                   std::make_move_iterator(string_buffer.end()));
+    string_buffer.clear();
+    string_sent_.resize(strings.size(), 0);
+    while (!shm_live_pages.empty() &&
+           shm_live_pages.front().end <= shm.tail()) {
+      shm_live_pages.pop_front();
+    }
+    shm_scratch.clear();
+    if (resync) {
+      // Sends again the strings of the pages still in the ring, newest
+      // first, and each other string on its next use. Stops at a quarter of
+      // the ring so that a resync never overwrites the pages it completes.
+      ++string_epoch_;
+      size_t bytes = 0;
+      for (auto page = shm_live_pages.rbegin();
+           page != shm_live_pages.rend() && bytes < shm.capacity() / 4;
+           ++page) {
+        for (int id : page->string_ids) bytes += QueueStringLocked(id);
+      }
+    }
+    std::sort(page_string_ids.begin(), page_string_ids.end());
+    page_string_ids.erase(
+        std::unique(page_string_ids.begin(), page_string_ids.end()),
+        page_string_ids.end());
+    for (int id : page_string_ids) QueueStringLocked(id);
+    SendStringsLocked();
+    // Series records: id, name, color, index of the first value, count,
+    // values.
+    for (size_t i = 0; i < series_buffer.size(); ++i) {
+      auto& pending = series_buffer[i];
+      for (size_t j = 0; j < pending.values.size();) {
+        const uint32_t count = static_cast<uint32_t>(
+            std::min<size_t>(pending.values.size() - j, 8192));
+        shm_scratch.clear();
+        BinaryWriter w(shm_scratch);
+        w.Write(static_cast<int>(i));
+        w.Write(series_[i].name);
+        w.Write(series_[i].color);
+        w.Write(static_cast<uint64_t>(pending.first + j));
+        w.Write(count);
+        w.WriteBytes(&pending.values[j], count * sizeof(double));
+        shm.Write(GvShmRing::kSeries, shm_scratch.data(), shm_scratch.size());
+        j += count;
+      }
+      pending.first += pending.values.size();
+      pending.values.clear();
+    }
+    if (buffer.empty()) {
+      return;
+    }
+    // Also forgets, and counts as dropped, the pages overwritten before the
+    // viewer read them.
+    PendingPagesLocked();
+    ApplyBackpressureLocked();
+    if (shm.Write(GvShmRing::kPage, buffer.data(), buffer.size())) {
+      shm_page_ends.push_back(shm.head());
+      shm_live_pages.emplace_back();
+      shm_live_pages.back().end = shm.head();
+      shm_live_pages.back().string_ids.swap(page_string_ids);
+    } else {
+      std::cerr << "page is too large for the shared memory" << std::endl;
+    }
+    buffer.clear();
+    page_string_ids.clear();
+  }
+
+  // Adds a string to the strings record being built in shm_scratch unless it
+  // was sent after the last resync. Returns the bytes added. Strings records:
+  // count, then pairs of id and string.
+  size_t QueueStringLocked(int id) {
+    if (string_sent_[id] == string_epoch_) return 0;
+    string_sent_[id] = string_epoch_;
+    if (shm_scratch.empty()) BinaryWriter(shm_scratch).Write(0);
+    const size_t size = shm_scratch.size();
+    BinaryWriter w(shm_scratch);
+    w.Write(id);
+    w.Write(strings[id]);
+    int count;
+    memcpy(&count, shm_scratch.data(), sizeof(count));
+    ++count;
+    memcpy(shm_scratch.data(), &count, sizeof(count));
+    const size_t added = shm_scratch.size() - size;
+    if (shm_scratch.size() >= (1 << 16)) SendStringsLocked();
+    return added;
+  }
+
+  void SendStringsLocked() {
+    if (shm_scratch.empty()) return;
+    shm.Write(GvShmRing::kStrings, shm_scratch.data(), shm_scratch.size());
+    shm_scratch.clear();
+  }
+
+  // Copies the records written by the producer process since the last call.
+  void ReceiveLocked() {
+    if (!shm.is_open()) {
+      if (!shm.Open(shm_name_.c_str())) return;
+      shm.RequestResync();
+    }
+    if (shm.producer_changed()) {
+      shm.Close();
+      commands.clear();
+      time_index.clear();
+      vis_time_index = 0;
+      shown_page_ = -1;
+      ++pages_version_;
+      strings.clear();
+      ClearTextTextures();
+      series_.clear();
+      dirty_series.clear();
+      page_serials.clear();
+      return;
+    }
+    const uint64_t lost = shm.lost();
+    GvShmRing::Record rec;
+    while (shm.Next(&rec)) {
+      if (rec.kind == GvShmRing::kPage) {
+        const size_t pos = commands.size();
+        commands.insert(commands.end(), rec.data, rec.data + rec.size);
+        if (!shm.Valid(rec)) {
+          commands.resize(pos);
+          continue;
+        }
+        if (auto_mode_) {
+          vis_time_index = static_cast<int>(time_index.size());
+        }
+        time_index.push_back(static_cast<int>(pos));
+        MarkPageLocked();
+      } else if (rec.kind == GvShmRing::kSeries) {
+        shm_scratch.assign(rec.data, rec.data + rec.size);
+        if (!shm.Valid(rec)) continue;
+        ReceiveSeriesLocked(shm_scratch);
+      } else if (rec.kind == GvShmRing::kStrings) {
+        shm_scratch.assign(rec.data, rec.data + rec.size);
+        if (!shm.Valid(rec)) continue;
+        BinaryReader r(shm_scratch);
+        int count;
+        r.Read(count);
+        for (int i = 0; i < count; ++i) {
+          int id;
+          r.Read(id);
+          if (strings.size() <= static_cast<size_t>(id)) {
+            strings.resize(id + 1);
+          }
+          r.Read(strings[id]);
+        }
+        // Texts that were referenced before their strings arrived. The page
+        // being shown is drawn again only if it may have used one of them.
+        for (auto kv = text_textures.begin(); kv != text_textures.end();) {
+          if (kv->second.tex) {
+            ++kv;
+            continue;
+          }
+          kv = text_textures.erase(kv);
+          progress.page = -1;
+        }
+      }
+    }
+    if (shm.lost() != lost) shm.RequestResync();
+    shm.Heartbeat();
+  }
+
+  void ReceiveSeriesLocked(std::vector<char>& data) {
+    BinaryReader r(data);
+    int id;
+    uint64_t first;
+    uint32_t count;
+    r.Read(id);
+    if (series_.size() <= static_cast<size_t>(id)) series_.resize(id + 1);
+    auto& s = series_[id];
+    r.Read(s.name);
+    r.Read(s.color);
+    r.Read(first);
+    r.Read(count);
+    if (s.values.empty()) s.base = first;
+    // Records lost in the ring leave a gap.
+    while (s.end() < first) s.Append(std::numeric_limits<double>::quiet_NaN());
+    std::vector<double> values(count);
+    r.ReadBytes(values.data(), count * sizeof(double));
+    for (uint32_t i = 0; i < count; ++i) {
+      if (first + i >= s.end()) s.Append(values[i]);
+    }
+    MarkSeriesDirtyLocked(id);
   }
 
   void UpdateCenter(int dx = 0, int dy = 0) {
@@ -564,28 +2526,11 @@ class GvSDL {
     center.y = std::round(std::max(std::min((double)center.y, uy), ly));
   }
 
-  // align_h: r is 0:center, 1:left 2:right
-  // align_v: r is 0:center, 1:top, 2:bottom
-  void RenderText(double x, double y, double r, int align_h, int align_v,
-                  GvColor c, const char* format = "?", ...) {
-    SDL_Color col;
-    col.r = c.r;
-    col.g = c.g;
-    col.b = c.b;
-    col.a = c.a;
-
-    char buf[1024];
-    va_list arg;
-    va_start(arg, format);
-    auto size = vsnprintf(buf, 256, format, arg);
-    va_end(arg);
-    if (size < 0) return;
-
-    SDL_Surface* surface = TTF_RenderUTF8_Blended(font, buf, col);
-    if (surface == nullptr) return;
-    GLuint texId;
-    glGenTextures(1, &texId);
-    glBindTexture(GL_TEXTURE_2D, texId);
+  bool CreateTextTexture(const char* text, GvTextTexture* dst) {
+    SDL_Color white;
+    white.r = white.g = white.b = white.a = 0xFF;
+    SDL_Surface* surface = TTF_RenderUTF8_Blended(font, text, white);
+    if (surface == nullptr) return false;
 
     const int w = next_power_of_two(surface->w);
     const int h = next_power_of_two(surface->h);
@@ -601,34 +2546,118 @@ class GvSDL {
     blit2_rect.y = (h - surface->h) * 0.5;
     blit2_rect.w = surface->w;
     blit2_rect.h = surface->h;
-
     SDL_BlitSurface(surface, &blit_rect, s, &blit2_rect);
+
+    glGenTextures(1, &dst->tex);
+    glBindTexture(GL_TEXTURE_2D, dst->tex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
                  s->pixels);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    dst->w = w;
+    dst->h = h;
+    dst->text_w = surface->w;
+    dst->text_h = surface->h;
+    SDL_FreeSurface(s);
+    SDL_FreeSurface(surface);
+    return true;
+  }
+
+  // Returns the text of an id given by InternString or FormatText.
+  const std::string* TextString(int id) const {
+    if (id >= 0) {
+      return static_cast<size_t>(id) < strings.size() ? &strings[id] : nullptr;
+    }
+    const size_t index = -(id + 1);
+    return index < formatted_strings.size() ? &formatted_strings[index]
+                                            : nullptr;
+  }
+
+  // Formats a deferred text and returns its id. Must be called with mtx
+  // locked.
+  int FormatText(int format_id, std::vector<char>& args) {
+    const std::string* format = TextString(format_id);
+    if (format == nullptr) return std::numeric_limits<int>::min();
+    BinaryReader reader(args);
+    GvFormatSpec::Format(format->c_str(), reader, 255, formatted_text);
+    return LocalTextId(formatted_text);
+  }
+
+  // Returns a negative id for a text which is not in the string table. Must
+  // be called with mtx locked.
+  int LocalTextId(const std::string& text) {
+    auto it = formatted_ids.find(text);
+    if (it != formatted_ids.end()) return it->second;
+    if (formatted_strings.size() >= kMaxFormattedTexts) {
+      for (auto kv = text_textures.begin(); kv != text_textures.end();) {
+        if (kv->first < 0) {
+          if (kv->second.tex) glDeleteTextures(1, &kv->second.tex);
+          kv = text_textures.erase(kv);
+        } else {
+          ++kv;
+        }
+      }
+      formatted_ids.clear();
+      formatted_strings.clear();
+    }
+    const int id = -1 - static_cast<int>(formatted_strings.size());
+    formatted_ids.emplace(text, id);
+    formatted_strings.push_back(text);
+    return id;
+  }
+
+  // Returns the cached texture of the text of id, or nullptr if it can not be
+  // rendered. Must be called with mtx locked.
+  const GvTextTexture* TextTexture(int id) {
+    auto it = text_textures.find(id);
+    if (it == text_textures.end()) {
+      if (text_textures.size() >= kMaxTextTextures) ClearTextTextures();
+      GvTextTexture t;
+      const std::string* text = TextString(id);
+      if (text == nullptr || !CreateTextTexture(text->c_str(), &t)) {
+        t.tex = 0;
+      }
+      it = text_textures.emplace(id, t).first;
+    }
+    return it->second.tex ? &it->second : nullptr;
+  }
+
+  void ClearTextTextures() {
+    for (auto& kv : text_textures) {
+      if (kv.second.tex) glDeleteTextures(1, &kv.second.tex);
+    }
+    text_textures.clear();
+  }
 
+  // align_h: r is 0:center, 1:left 2:right
+  // align_v: r is 0:center, 1:top, 2:bottom
+  void DrawTextTexture(const GvTextTexture& t, double x, double y, double r,
+                       int align_h, int align_v, GvColor c) {
     auto center = Point<double>(x, y);
-    double scale = r / surface->h;
-    double lx = center.x - (w * scale * 0.5);
-    double ly = center.y - (h * scale * 0.5);
-    double ux = center.x + (w * scale * 0.5);
-    double uy = center.y + (h * scale * 0.5);
+    double scale = r / t.text_h;
+    double lx = center.x - (t.w * scale * 0.5);
+    double ly = center.y - (t.h * scale * 0.5);
+    double ux = center.x + (t.w * scale * 0.5);
+    double uy = center.y + (t.h * scale * 0.5);
     if (align_h == 1) {  // left
-      lx += surface->w * scale * 0.5;
-      ux += surface->w * scale * 0.5;
+      lx += t.text_w * scale * 0.5;
+      ux += t.text_w * scale * 0.5;
     } else if (align_h == 2) {  // right
-      lx -= surface->w * scale * 0.5;
-      ux -= surface->w * scale * 0.5;
+      lx -= t.text_w * scale * 0.5;
+      ux -= t.text_w * scale * 0.5;
     }
     if (align_v == 1) {  // top
-      ly += surface->h * scale * 0.5;
-      uy += surface->h * scale * 0.5;
+      ly += t.text_h * scale * 0.5;
+      uy += t.text_h * scale * 0.5;
     } else if (align_v == 2) {  // bottom
-      ly -= surface->h * scale * 0.5;
-      uy -= surface->h * scale * 0.5;
+      ly -= t.text_h * scale * 0.5;
+      uy -= t.text_h * scale * 0.5;
     }
 
+    glColor4f(c.r / 256.0, c.g / 256.0, c.b / 256.0, c.a / 256.0);
+    glBindTexture(GL_TEXTURE_2D, t.tex);
     glEnable(GL_TEXTURE_2D);
     glBegin(GL_QUADS);
     {
@@ -643,92 +2672,538 @@ class GvSDL {
     }
     glEnd();
     glDisable(GL_TEXTURE_2D);
-    SDL_FreeSurface(s);
-    SDL_FreeSurface(surface);
-    glDeleteTextures(1, &texId);
     glBindTexture(GL_TEXTURE_2D, 0);
   }
 
+  // Renders a text which is not in the string table. The texture is not
+  // cached, use it for texts that change every frame.
+  void RenderText(double x, double y, double r, int align_h, int align_v,
+                  GvColor c, const char* format = "?", ...) {
+    char buf[1024];
+    va_list arg;
+    va_start(arg, format);
+    auto size = vsnprintf(buf, 256, format, arg);
+    va_end(arg);
+    if (size < 0) return;
+
+    GvTextTexture t;
+    if (!CreateTextTexture(buf, &t)) return;
+    DrawTextTexture(t, x, y, r, align_h, align_v, c);
+    glDeleteTextures(1, &t.tex);
+  }
+
   void Render() {
     render_args.font = font;
+    render_args.text_size_func = [this](int id, int* w, int* h) {
+      const GvTextTexture* t = this->TextTexture(id);
+      if (t == nullptr) return false;
+      *w = t->text_w;
+      *h = t->text_h;
+      return true;
+    };
     render_args.render_text_func = [this](double x, double y, double r,
                                           int align_h, int align_v, GvColor c,
-                                          const char* text) {
-      this->RenderText(x, y, r, align_h, align_v, c, text);
+                                          int id) {
+      const GvTextTexture* t = this->TextTexture(id);
+      if (t != nullptr) this->DrawTextTexture(*t, x, y, r, align_h, align_v, c);
+    };
+    render_args.format_text_func = [this](int format_id,
+                                          std::vector<char>& args) {
+      return this->FormatText(format_id, args);
     };
 
     SDL_GetWindowSize(window, &window_width, &window_height);
+    glViewport(0, 0, window_width, window_height);
 
-    const auto content_w = content_box.ux - content_box.lx;
-    const auto content_h = content_box.uy - content_box.ly;
+    mtx.lock();
+    const int page = RenderPageLocked();
+    shown_page_ = time_index.empty() ? -1 : page;
+    if (!time_index.empty()) {
+      viewed_pages_ = std::max(viewed_pages_, page + 1);
+    }
+    if (show_charts_) RenderChartsLocked(page);
+    auto cur_index = page + 1;
+    auto max_index = time_index.size();
+    const auto dropped = dropped_pages_;
+    const auto coalesced = coalesced_pages_;
+    const auto overruns = shm_name_.empty() ? 0 : shm.lost();
+    mtx.unlock();
+    viewed_cv.notify_all();
+
+    double mousex, mousey;
+    MouseWorldPoint(&mousex, &mousey);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-window_width * 0.5, window_width * 0.5, window_height * 0.5,
+            -window_height * 0.5, 0, 16);
+    RenderText(-window_width * 0.5, window_height * 0.5, 20, 1, 2,
+               ColorIndex(1), "Time(%d / %d) Mouse(%f, %f)", cur_index,
+               max_index, mousex, mousey);
+    if (dropped || coalesced) {
+      RenderText(-window_width * 0.5, window_height * 0.5 - 20, 20, 1, 2,
+                 ColorIndex(1), "Dropped(%llu) Coalesced(%llu)",
+                 static_cast<unsigned long long>(dropped),
+                 static_cast<unsigned long long>(coalesced));
+    }
+    if (overruns) {
+      // Times the producer overwrote records this viewer had not read; each
+      // may cover several pages.
+      RenderText(-window_width * 0.5, window_height * 0.5 - 20, 20, 1, 2,
+                 ColorIndex(1), "Overrun(%llu)",
+                 static_cast<unsigned long long>(overruns));
+    }
+
+    SDL_RenderPresent(renderer);
+    if (startup_.first_frame_ms < 0) {
+      mtx.lock();
+      startup_.first_frame_ms = StartupMs();
+      mtx.unlock();
+    }
+  }
+
+  // Number of samples of the longest series.
+  size_t ChartSamples() {
+    mtx.lock();
+    size_t n = 0;
+    for (const auto& s : series_) n = std::max(n, s.end());
+    mtx.unlock();
+    return n;
+  }
+
+  // Draws each series in a band at the top of the window, up to the samples
+  // flushed with the page. A pixel column shows the range of its samples, so
+  // a chart costs O(width log n) for any number of samples.
+  void RenderChartsLocked(int page) {
+    if (series_.empty()) return;
+    // No page yet happens in the viewer when series records arrive before
+    // the first page of a producer.
+    const bool latest =
+        page < 0 || page >= static_cast<int>(page_serials.size()) ||
+        (auto_mode_ && page + 1 == static_cast<int>(time_index.size()));
+    const double band_h = 64;
+    const double margin = 8;
+    const int cols = window_width - 2 * static_cast<int>(margin);
+    if (cols < 2) return;
+
+    // Keeps the world projection for MouseWorldPoint.
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, window_width, window_height, 0, 0, 16);
+
+    double top = margin;
+    for (const auto& s : series_) {
+      if (top + band_h > window_height * 0.5) break;
+      const size_t end = latest ? s.end() : s.CountAt(page_serials[page]);
+      size_t begin = s.base;
+      if (chart_span_ > 0 && end > chart_span_) {
+        begin = std::max(begin, end - chart_span_);
+      }
+      if (end <= begin) continue;
+
+      glColor4f(1, 1, 1, 0.75);
+      glBegin(GL_QUADS);
+      glVertex2d(margin, top);
+      glVertex2d(margin + cols, top);
+      glVertex2d(margin + cols, top + band_h);
+      glVertex2d(margin, top + band_h);
+      glEnd();
+
+      double lo, hi;
+      s.Range(begin, end, &lo, &hi);
+      if (!std::isnan(lo)) {
+        const double label_lo = lo;
+        const double label_hi = hi;
+        if (!(hi > lo)) {
+          lo -= 0.5;
+          hi += 0.5;
+        }
+        const double scale = (band_h - 4) / (hi - lo);
+        const double bottom = top + band_h - 2;
+        const auto& c = s.color;
+        glColor4f(c.r / 256.0, c.g / 256.0, c.b / 256.0, c.a / 256.0);
+        const size_t n = end - begin;
+        if (n <= static_cast<size_t>(cols)) {
+          const double dx = n > 1 ? static_cast<double>(cols) / (n - 1) : 0;
+          glBegin(GL_LINE_STRIP);
+          for (size_t i = 0; i < n; ++i) {
+            const double v = s.values[begin - s.base + i];
+            if (std::isnan(v)) {
+              glEnd();
+              glBegin(GL_LINE_STRIP);
+              continue;
+            }
+            glVertex2d(margin + i * dx, bottom - (v - lo) * scale);
+          }
+          glEnd();
+        } else {
+          // Each column also reaches the previous one so the line is joined.
+          double prev_lo = std::numeric_limits<double>::quiet_NaN();
+          double prev_hi = prev_lo;
+          glBegin(GL_LINES);
+          for (int i = 0; i < cols; ++i) {
+            double col_lo, col_hi;
+            s.Range(begin + n * i / cols, begin + n * (i + 1) / cols, &col_lo,
+                    &col_hi);
+            double a = col_lo;
+            double b = col_hi;
+            if (!std::isnan(a) && !std::isnan(prev_lo)) {
+              a = std::min(a, prev_hi);
+              b = std::max(b, prev_lo);
+            }
+            prev_lo = col_lo;
+            prev_hi = col_hi;
+            if (std::isnan(a)) continue;
+            glVertex2d(margin + i + 0.5, bottom - (a - lo) * scale + 0.5);
+            glVertex2d(margin + i + 0.5, bottom - (b - lo) * scale - 0.5);
+          }
+          glEnd();
+        }
+        RenderText(margin + 4, top + 2, 14, 1, 1, c, "%s %g [%g, %g]",
+                   s.name.c_str(), s.values[end - 1 - s.base], label_lo,
+                   label_hi);
+      }
+      top += band_h + margin;
+    }
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+  }
+
+  void SetWorldProjection(const BoundingBox<double>& box) {
+    const auto content_w = box.ux - box.lx;
+    const auto content_h = box.uy - box.ly;
     double scale =
         std::min(window_width / content_w, window_height / content_h);
 
     glMatrixMode(GL_PROJECTION);
-    glViewport(0, 0, window_width, window_height);
-
     glLoadIdentity();
     glOrtho(-window_width * 0.5, window_width * 0.5, window_height * 0.5,
             -window_height * 0.5, 0, 16);
     glTranslated(center.x, center.y, 0);
     glScaled(scale * zoom, scale * zoom, 1);
-    glTranslated(-content_box.lx - content_w * 0.5,
-                 -content_box.ly - content_h * 0.5, 0);
+    glTranslated(-box.lx - content_w * 0.5, -box.ly - content_h * 0.5, 0);
+  }
+
+  template <typename Item>
+  void ReadTriangles(BinaryReader& reader, Item& item, std::vector<double>* xy,
+                     std::vector<GvColor>* colors) {
+    Item::ReadFrom(reader, item);
+    content_box.Update(item);
+    if (xy == nullptr) return;
+    item.Triangulate(triangulator, *xy);
+    colors->resize(xy->size() / 2, item.c);
+  }
 
+  // Picks about one command in eight by its position, so that every slice
+  // of the coarse pass picks the same ones.
+  static bool CoarseSample(size_t pos) {
+    return (static_cast<uint64_t>(pos) * 0x9E3779B97F4A7C15ull) >> 61 == 0;
+  }
+
+  // Draws the commands in [pos, end) until deadline and returns where it
+  // stopped. Must be called with mtx locked.
+  size_t DrawCommandsLocked(
+      size_t pos, size_t end, bool coarse,
+      std::chrono::steady_clock::time_point deadline =
+          std::chrono::steady_clock::time_point::max()) {
     GvPolygonItem<double> polygon_item;
+    GvShapeItem<double> shape_item;
+    GvPolylineItem<double> polyline_item;
     GvCircleItem<double> circle_item;
     GvTextItem<double> text_item;
+    GvFormatTextItem<double> format_text_item;
+    GvDensityItem<double> density_item;
+    render_args.coarse = coarse;
+
+    DensityCache& dc = densities;
+    if (dc.version != pages_version_ || dc.end != end) {
+      for (auto& kv : dc.textures) glDeleteTextures(1, &kv.second);
+      dc.textures.clear();
+      dc.version = pages_version_;
+      dc.end = end;
+    }
+
+    TriangleCache& tc = triangles;
+    // A new page starts where the previous one ended, so the cache is keyed
+    // by the end of the page, not only by the range it has built.
+    if (tc.version != pages_version_ || tc.end != end || pos < tc.start ||
+        tc.built_until < pos) {
+      tc.version = pages_version_;
+      tc.end = end;
+      tc.start = tc.built_until = pos;
+      tc.entries.clear();
+      tc.xy.clear();
+      tc.colors.clear();
+    }
+    size_t cursor =
+        std::lower_bound(tc.entries.begin(), tc.entries.end(), pos,
+                         [](const TriangleCache::Entry& e, size_t p) {
+                           return e.pos < p;
+                         }) -
+        tc.entries.begin();
+    // Consecutive polygons are drawn with one call.
+    size_t batch_first = 0, batch_count = 0;
+    // The coarse pass also draws polygons which are not in the cache yet
+    // from coarse_xy, without adding them to the cache.
+    coarse_xy.clear();
+    coarse_colors.clear();
+    auto flush = [&] {
+      if (batch_count == 0 && coarse_xy.empty()) return;
+      glEnableClientState(GL_VERTEX_ARRAY);
+      glEnableClientState(GL_COLOR_ARRAY);
+      if (batch_count) {
+        glVertexPointer(2, GL_DOUBLE, 0, tc.xy.data());
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, tc.colors.data());
+        glDrawArrays(GL_TRIANGLES, batch_first, batch_count);
+      }
+      if (!coarse_xy.empty()) {
+        glVertexPointer(2, GL_DOUBLE, 0, coarse_xy.data());
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, coarse_colors.data());
+        glDrawArrays(GL_TRIANGLES, 0, coarse_xy.size() / 2);
+      }
+      glDisableClientState(GL_COLOR_ARRAY);
+      glDisableClientState(GL_VERTEX_ARRAY);
+      batch_count = 0;
+      coarse_xy.clear();
+      coarse_colors.clear();
+    };
 
     double vis_time = 0;
-    mtx.lock();
-    if (!time_index.empty()) {
-      BinaryReader reader(commands, time_index[vis_time_index]);
-      bool visit_t = false;
-      while (reader.pos() < commands.size()) {
-        char cmd;
-        reader.Read(cmd);
-        if (cmd == 'n' && visit_t) {
-          break;
-        } else if (cmd == 'n') {
-          visit_t = true;
-          reader.Read(vis_time);
-        } else if (cmd == 'p') {
-          GvPolygonItem<double>::ReadFrom(reader, polygon_item);
-          polygon_item.Render(render_args);
-          content_box.Update(polygon_item);
-        } else if (cmd == 'c') {
-          reader.Read(circle_item);
-          circle_item.Render(render_args);
-          content_box.Update(circle_item);
-        } else if (cmd == 't') {
-          GvTextItem<double>::ReadFrom(reader, text_item);
-          if (font == nullptr) {
-            std::cerr << "no font" << std::endl;
-            continue;
+    BinaryReader reader(commands, pos);
+    // Reads a polygon command and appends its triangles to xy and colors
+    // unless they are null.
+    auto read_polygon = [&](char cmd, std::vector<double>* xy,
+                            std::vector<GvColor>* colors) {
+      if (cmd == 'p') {
+        ReadTriangles(reader, polygon_item, xy, colors);
+      } else if (cmd == 'P') {
+        ReadTriangles(reader, shape_item, xy, colors);
+      } else {
+        ReadTriangles(reader, polyline_item, xy, colors);
+      }
+    };
+    for (int count = 1; reader.pos() < end; ++count) {
+      if (count % 64 == 0 && std::chrono::steady_clock::now() > deadline) {
+        break;
+      }
+      const size_t cmd_pos = reader.pos();
+      char cmd;
+      reader.Read(cmd);
+      if (cmd == 'p' || cmd == 'P' || cmd == 'l') {
+        TriangleCache::Entry entry;
+        // The coarse pass draws about one polygon in eight and leaves
+        // triangulating the page to the full pass.
+        const bool sampled = !coarse || CoarseSample(cmd_pos);
+        if (cmd_pos < tc.built_until) {
+          entry = tc.entries[cursor++];
+          reader.pos(entry.next);
+          if (!sampled) continue;
+          if (!coarse_xy.empty()) flush();
+        } else if (coarse) {
+          if (sampled && batch_count) flush();
+          read_polygon(cmd, sampled ? &coarse_xy : nullptr,
+                       sampled ? &coarse_colors : nullptr);
+          continue;
+        } else {
+          entry.pos = cmd_pos;
+          const size_t first = tc.xy.size();
+          read_polygon(cmd, &tc.xy, &tc.colors);
+          entry.first = first / 2;
+          entry.count = (tc.xy.size() - first) / 2;
+          entry.next = tc.built_until = reader.pos();
+          tc.entries.push_back(entry);
+          cursor = tc.entries.size();
+        }
+        if (batch_count && batch_first + batch_count == entry.first) {
+          batch_count += entry.count;
+        } else {
+          flush();
+          batch_first = entry.first;
+          batch_count = entry.count;
+        }
+        continue;
+      }
+      flush();
+      if (cmd == 'n') {
+        reader.Read(vis_time);
+      } else if (cmd == 'c') {
+        reader.Read(circle_item);
+        circle_item.Render(render_args);
+        content_box.Update(circle_item);
+      } else if (cmd == 't' || cmd == 'T') {
+        GvTextItem<double>::ReadFrom(reader, text_item);
+        if (cmd == 'T') {
+          reader.Read(inline_text);
+          if (font != nullptr && !coarse) {
+            text_item.id = LocalTextId(inline_text);
           }
+        }
+        if (font == nullptr) {
+          if (!font_future_.valid()) std::cerr << "no font" << std::endl;
+        } else if (!coarse) {
           text_item.Render(render_args);
           content_box.Update(text_item);
-        } else {
-          std::cerr << "Unknown command" << std::endl;
         }
+      } else if (cmd == 'f') {
+        GvFormatTextItem<double>::ReadFrom(reader, format_text_item);
+        if (font == nullptr) {
+          if (!font_future_.valid()) std::cerr << "no font" << std::endl;
+        } else if (!coarse) {
+          format_text_item.Render(render_args);
+          content_box.Update(format_text_item);
+        }
+      } else if (cmd == 'd') {
+        GvDensityItem<double>::ReadFrom(reader, density_item);
+        GLuint& tex = densities.textures[cmd_pos];
+        if (tex == 0) tex = density_item.CreateTexture();
+        density_item.Render(tex);
+        content_box.Update(density_item);
+      } else {
+        std::cerr << "Unknown command" << std::endl;
       }
+      if (cmd_pos == tc.built_until) tc.built_until = reader.pos();
     }
-    auto cur_index = vis_time_index + 1;
-    auto max_index = time_index.size();
-    mtx.unlock();
+    flush();
+    return reader.pos();
+  }
 
-    double mousex, mousey;
-    MouseWorldPoint(&mousex, &mousey);
+  static bool SameBox(const BoundingBox<double>& a,
+                      const BoundingBox<double>& b) {
+    return a.lx == b.lx && a.ly == b.ly && a.ux == b.ux && a.uy == b.uy;
+  }
 
+  // Draws tex over the whole window.
+  void DrawProgressTexture(GLuint tex) {
+    const Progress& p = progress;
     glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
     glLoadIdentity();
-    glOrtho(-window_width * 0.5, window_width * 0.5, window_height * 0.5,
-            -window_height * 0.5, 0, 16);
-    RenderText(-window_width * 0.5, window_height * 0.5, 20, 1, 2,
-               ColorIndex(1), "Time(%d / %d) Mouse(%f, %f)", cur_index,
-               max_index, mousex, mousey);
+    glOrtho(0, window_width, 0, window_height, -1, 1);
+    glDisable(GL_BLEND);
+    glColor4f(1, 1, 1, 1);
+    glBindTexture(GL_TEXTURE_2D, tex);
+    glEnable(GL_TEXTURE_2D);
+    const double tx = static_cast<double>(p.width) / p.tex_w;
+    const double ty = static_cast<double>(p.height) / p.tex_h;
+    glBegin(GL_QUADS);
+    {
+      glTexCoord2d(0, 0);
+      glVertex2d(0, 0);
+      glTexCoord2d(tx, 0);
+      glVertex2d(p.width, 0);
+      glTexCoord2d(tx, ty);
+      glVertex2d(p.width, p.height);
+      glTexCoord2d(0, ty);
+      glVertex2d(0, p.height);
+    }
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_BLEND);
+    glPopMatrix();
+  }
 
-    SDL_RenderPresent(renderer);
+  void ResizeProgressTextures() {
+    Progress& p = progress;
+    const int w = next_power_of_two(std::max(window_width, 1));
+    const int h = next_power_of_two(std::max(window_height, 1));
+    if (p.tex[0] && p.tex_w == w && p.tex_h == h) return;
+    if (!p.tex[0]) glGenTextures(2, p.tex);
+    for (GLuint tex : p.tex) {
+      glBindTexture(GL_TEXTURE_2D, tex);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, nullptr);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    p.tex_w = w;
+    p.tex_h = h;
+  }
+
+  // Draws a slice of the visible page and returns the index of the page on
+  // the screen. In auto mode a page is kept until one pass of it has been
+  // finished, so that fast producers still show complete pages. Must be
+  // called with mtx locked.
+  int RenderPageLocked() {
+    if (time_index.empty()) {
+      SetWorldProjection(content_box);
+      return vis_time_index;
+    }
+    Progress& p = progress;
+    const bool same_view = p.version == pages_version_ &&
+                           p.center.x == center.x && p.center.y == center.y &&
+                           p.zoom == zoom && p.width == window_width &&
+                           p.height == window_height &&
+                           p.font == (font != nullptr);
+    const bool keep_page = auto_mode_ && same_view && p.page >= 0 &&
+                           p.page < static_cast<int>(time_index.size()) &&
+                           !p.has_finished;
+    const int page = keep_page ? p.page : vis_time_index;
+    const size_t begin = time_index[page];
+    const size_t end = page + 1 < static_cast<int>(time_index.size())
+                           ? time_index[page + 1]
+                           : commands.size();
+
+    if (render_slice_ms_ <= 0) {
+      SetWorldProjection(content_box);
+      DrawCommandsLocked(begin, end, false);
+      p.page = -1;
+      return page;
+    }
+
+    if (!same_view || p.page != page || p.begin != begin || p.end != end) {
+      p.page = page;
+      p.version = pages_version_;
+      p.center = center;
+      p.zoom = zoom;
+      p.width = window_width;
+      p.height = window_height;
+      p.font = font != nullptr;
+      p.box = content_box;
+      p.begin = p.pos = begin;
+      p.end = end;
+      p.pass =
+          end - begin > kCoarsePageBytes ? Progress::kCoarse : Progress::kFull;
+      p.has_finished = false;
+      ResizeProgressTextures();
+    }
+
+    if (p.pass == Progress::kDone) {
+      DrawProgressTexture(p.tex[1]);
+      SetWorldProjection(p.box);
+      return page;
+    }
+
+    if (p.pos != p.begin) DrawProgressTexture(p.tex[0]);
+    SetWorldProjection(p.box);
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::microseconds(
+                              static_cast<int64_t>(render_slice_ms_ * 1000));
+    p.pos = DrawCommandsLocked(p.pos, p.end, p.pass == Progress::kCoarse,
+                               deadline);
+    glBindTexture(GL_TEXTURE_2D, p.tex[0]);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, p.width, p.height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (p.pos == p.end) {
+      p.pos = p.begin;
+      if (!SameBox(p.box, content_box)) {
+        // The content grew while drawing; draw the pass again to fit it.
+        p.box = content_box;
+      } else {
+        std::swap(p.tex[0], p.tex[1]);
+        p.has_finished = true;
+        p.pass =
+            p.pass == Progress::kCoarse ? Progress::kFull : Progress::kDone;
+      }
+    }
+    if (p.pass != Progress::kDone && p.has_finished) {
+      DrawProgressTexture(p.tex[1]);
+      SetWorldProjection(p.box);
+    }
+    return page;
   }
 
   void MouseWorldPoint(double* x, double* y) {
@@ -748,6 +3223,7 @@ class GvSDL {
   }
 
   void MainLoop() {
+    OpenWindow();
     bool running = true;
     render_args.renderer = renderer;
 
@@ -783,6 +3259,19 @@ class GvSDL {
                 mtx.unlock();
               }
               break;
+            case SDLK_g:
+              show_charts_ = !show_charts_;
+              break;
+            case SDLK_LEFTBRACKET:
+              if (chart_span_ > 0) {
+                chart_span_ *= 2;
+                if (chart_span_ >= ChartSamples()) chart_span_ = 0;
+              }
+              break;
+            case SDLK_RIGHTBRACKET:
+              chart_span_ = std::max<size_t>(
+                  (chart_span_ ? chart_span_ : ChartSamples()) / 2, 16);
+              break;
             case SDLK_ESCAPE:
               running = false;
               break;
@@ -806,9 +3295,20 @@ class GvSDL {
         }
       }
 
+      if (!shm_name_.empty()) {
+        mtx.lock();
+        ReceiveLocked();
+        mtx.unlock();
+      }
       FontCheck();
       Render();
+      ReportStartup();
     }
+    mtx.lock();
+    viewer_running_ = false;
+    mtx.unlock();
+    viewed_cv.notify_all();
+    if (font_future_.valid()) font = font_future_.get();
     SDL_Quit();
   }
 };
@@ -818,19 +3318,43 @@ struct GvEmpty {
   GvColor Color(...) { return 0; }
   GvColor ColorIndex(...) { return 0; }
   void Flush(...) {}
-  void NewTime(...) {}
+  bool NewTime(...) { return false; }
+  bool recording(...) { return false; }
   void RunMainThread(std::function<void()> f) { f(); }
   void RunSubThread(...) {}
+  void RunSharedMemory(...) {}
+  void RunViewer(...) {}
+  void RemoveSharedMemory(...) {}
   void Line(...) {}
   void Circle(...) {}
   void Rect(...) {}
+  void Polygon(...) {}
+  void Polyline(...) {}
   void Text(...) {}
+  void Density(...) {}
   void Arrow(...) {}
   void font_path(...) {}
   std::string font_path() { return ""; }
   void default_alpha(...) { return; }
   uint8_t default_alpha() { return 0; }
   bool enabled(...) { return false; }
+  bool deferred_text(...) { return false; }
+  double max_pages_per_second(...) { return 0; }
+  int sample_every(...) { return 1; }
+  bool skip_when_paused(...) { return false; }
+  double render_slice_ms(...) { return 0; }
+  int msaa_samples(...) { return 0; }
+  size_t max_string_table_bytes(...) { return 0; }
+  GvStartupStats startup_stats() { return GvStartupStats(); }
+  int Series(...) { return -1; }
+  void Plot(...) {}
+  size_t chart_span(...) { return 0; }
+  void backpressure(...) {}
+  GvBackpressure::Policy backpressure() { return GvBackpressure::kKeepAll; }
+  int max_pending_pages() { return 0; }
+  int pending_pages() { return 0; }
+  uint64_t dropped_pages() { return 0; }
+  uint64_t coalesced_pages() { return 0; }
 };
 
 }  // namespace gv_internal
@@ -840,3 +3364,5 @@ static gv_internal::GvSDL gv;
 #else
 static gv_internal::GvEmpty gv;
 #endif
+using gv_internal::GvBackpressure;
+using gv_internal::GvStartupStats;
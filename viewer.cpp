@@ -0,0 +1,16 @@
+/*
+ The MIT License (MIT)
+ Copyright (c) 2016 Shingo INADA
+ https://opensource.org/licenses/mit-license.php
+*/
+
+// Shows the pages of a program which calls gv.RunSharedMemory().
+// usage: viewer [shared memory name] [font path]
+
+#include "gv.hpp"
+
+int main(int argc, char** argv) {
+  gv.font_path(argc > 2 ? argv[2] : "MTLmr3m.ttf");
+  gv.RunViewer(argc > 1 ? argv[1] : "/gv");
+  return 0;
+}